@@ -0,0 +1,335 @@
+/********************************************************************
+ * File         : bbvprof.cpp
+ * Description  : SimPoint style profiler. Builds a basic block vector
+ *                per fixed-size interval of a .ptr.gz trace, clusters
+ *                the intervals with k-means and writes one weighted
+ *                simulation point per cluster (use with -simpoints)
+ *********************************************************************/
+
+#include <iostream>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <math.h>
+
+#include "trace.h"
+
+#define BBV_DIMS        15     // random projection width (as in SimPoint)
+#define KMEANS_ITERS    100
+#define MAX_CLUSTERS    64
+
+
+/*********************************************************************
+ * Global Scope Functions
+ *********************************************************************/
+
+void die_message(const char *msg) {
+    printf("Error! %s. Exiting...\n", msg);
+    exit(1);
+}
+
+void die_usage() {
+    printf("Usage : bbvprof [options] <trace_file> \n\n");
+    printf("Basic block vector profiler and simulation point picker\n");
+    printf("Options\n");
+    printf("   -interval    <num>    Instructions per interval (Default: 100000)\n");
+    printf("   -k           <num>    Number of clusters / simulation points (Default: 10, Max: %d)\n", MAX_CLUSTERS);
+    printf("   -o           <file>   Write simulation points to <file> (Default: stdout)\n");
+    exit(0);
+}
+
+
+/*********************************************************************
+ * Params and Globals
+ *********************************************************************/
+uint64_t  INTERVAL_INSTS=100000;
+uint32_t  NUM_CLUSTERS=10;
+
+double   *bbv;              // [num_intervals][BBV_DIMS], normalized
+uint64_t  num_intervals;
+uint64_t  max_intervals;
+
+
+/*********************************************************************
+ * Deterministic hashing, used for the projection and k-means++ seeding
+ *********************************************************************/
+
+static inline uint64_t splitmix64(uint64_t x) {
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+// Projection weight of basic block bb_addr onto dimension dd, in [-1,1)
+static inline double proj_weight(uint64_t bb_addr, int dd) {
+    uint64_t h = splitmix64(bb_addr * BBV_DIMS + dd);
+    return (double)(h >> 11) / (double)(1ULL << 52) - 1.0;
+}
+
+static double dist2(const double *a, const double *b) {
+    double d = 0;
+    for(int dd = 0; dd < BBV_DIMS; dd++) {
+        d += (a[dd]-b[dd])*(a[dd]-b[dd]);
+    }
+    return d;
+}
+
+/*********************************************************************
+ * Profile: one projected, normalized BBV per interval
+ *********************************************************************/
+
+void add_interval(double *vec, uint64_t insts) {
+    if(num_intervals == max_intervals) {
+        max_intervals = max_intervals ? 2*max_intervals : 1024;
+        bbv = (double *) realloc (bbv, max_intervals*BBV_DIMS*sizeof(double));
+    }
+    for(int dd = 0; dd < BBV_DIMS; dd++) {
+        bbv[num_intervals*BBV_DIMS + dd] = vec[dd]/(double)insts;
+    }
+    num_intervals++;
+}
+
+void profile(FILE *tr_file) {
+    Trace_Rec trace;
+    double   vec[BBV_DIMS] = {0};
+    uint64_t interval_insts = 0;
+    uint64_t bb_addr = 0;
+    uint64_t bb_len = 0;
+
+    while(fread(&trace, 1, sizeof(Trace_Rec), tr_file) == sizeof(Trace_Rec)) {
+        if(bb_len == 0) {
+            bb_addr = trace.inst_addr;
+        }
+        bb_len++;
+        interval_insts++;
+
+        // a conditional branch ends the block, so does the interval end
+        bool end_interval = (interval_insts == INTERVAL_INSTS);
+        if(trace.op_type == OP_CBR || end_interval) {
+            for(int dd = 0; dd < BBV_DIMS; dd++) {
+                vec[dd] += (double)bb_len * proj_weight(bb_addr, dd);
+            }
+            bb_len = 0;
+        }
+
+        if(end_interval) {
+            add_interval(vec, interval_insts);
+            memset(vec, 0, sizeof(vec));
+            interval_insts = 0;
+        }
+    }
+
+    // keep a trailing partial interval only if it is reasonably long
+    if(interval_insts >= INTERVAL_INSTS/2) {
+        if(bb_len) {
+            for(int dd = 0; dd < BBV_DIMS; dd++) {
+                vec[dd] += (double)bb_len * proj_weight(bb_addr, dd);
+            }
+        }
+        add_interval(vec, interval_insts);
+    }
+}
+
+/*********************************************************************
+ * k-means (k-means++ seeding), returns the cluster of each interval
+ *********************************************************************/
+
+void kmeans(uint32_t k, uint32_t *assign, double *centers) {
+    double *mind = (double *) calloc (num_intervals, sizeof(double));
+    uint64_t ii;
+    uint64_t seed = 42;
+
+    // k-means++: first center is interval 0, later ones by D^2 weight
+    memcpy(centers, &bbv[0], BBV_DIMS*sizeof(double));
+    for(ii = 0; ii < num_intervals; ii++) {
+        mind[ii] = dist2(&bbv[ii*BBV_DIMS], centers);
+    }
+    for(uint32_t cc = 1; cc < k; cc++) {
+        double total = 0;
+        for(ii = 0; ii < num_intervals; ii++) {
+            total += mind[ii];
+        }
+        seed = splitmix64(seed);
+        double pick = total * (double)(seed >> 11) / (double)(1ULL << 53);
+        uint64_t chosen = num_intervals-1;
+        for(ii = 0; ii < num_intervals; ii++) {
+            if(pick < mind[ii]) {
+                chosen = ii;
+                break;
+            }
+            pick -= mind[ii];
+        }
+        memcpy(&centers[cc*BBV_DIMS], &bbv[chosen*BBV_DIMS], BBV_DIMS*sizeof(double));
+        for(ii = 0; ii < num_intervals; ii++) {
+            double d = dist2(&bbv[ii*BBV_DIMS], &centers[cc*BBV_DIMS]);
+            if(d < mind[ii]) {
+                mind[ii] = d;
+            }
+        }
+    }
+
+    // Lloyd iterations
+    for(ii = 0; ii < num_intervals; ii++) {
+        assign[ii] = (uint32_t)-1;
+    }
+    for(int iter = 0; iter < KMEANS_ITERS; iter++) {
+        bool changed = false;
+        for(ii = 0; ii < num_intervals; ii++) {
+            uint32_t best = 0;
+            double bestd = dist2(&bbv[ii*BBV_DIMS], &centers[0]);
+            for(uint32_t cc = 1; cc < k; cc++) {
+                double d = dist2(&bbv[ii*BBV_DIMS], &centers[cc*BBV_DIMS]);
+                if(d < bestd) {
+                    bestd = d;
+                    best = cc;
+                }
+            }
+            if(assign[ii] != best) {
+                assign[ii] = best;
+                changed = true;
+            }
+        }
+        if(!changed) {
+            break;
+        }
+
+        uint64_t count[MAX_CLUSTERS] = {0};
+        memset(centers, 0, k*BBV_DIMS*sizeof(double));
+        for(ii = 0; ii < num_intervals; ii++) {
+            count[assign[ii]]++;
+            for(int dd = 0; dd < BBV_DIMS; dd++) {
+                centers[assign[ii]*BBV_DIMS + dd] += bbv[ii*BBV_DIMS + dd];
+            }
+        }
+        for(uint32_t cc = 0; cc < k; cc++) {
+            for(int dd = 0; dd < BBV_DIMS && count[cc]; dd++) {
+                centers[cc*BBV_DIMS + dd] /= (double)count[cc];
+            }
+        }
+    }
+
+    free(mind);
+}
+
+/*********************************************************************
+ * Main
+ *********************************************************************/
+
+int main(int argc, char *argv[])
+{
+    int ii;
+    FILE *tr_file;
+    FILE *out_file = stdout;
+    char tr_filename[1024] = "";
+    char out_filename[1024] = "";
+    char cmd_string[1100];
+
+    for ( ii = 1; ii < argc; ii++) {
+	if (argv[ii][0] == '-') {
+	    if (!strcmp(argv[ii], "-h") || !strcmp(argv[ii], "-help")) {
+		die_usage();
+	    }
+	    else if (!strcmp(argv[ii], "-interval")) {
+		if (ii < argc - 1) {
+		    INTERVAL_INSTS = atoll(argv[ii+1]);
+		    ii += 1;
+		}
+	    }
+	    else if (!strcmp(argv[ii], "-k")) {
+		if (ii < argc - 1) {
+		    NUM_CLUSTERS = atoi(argv[ii+1]);
+		    ii += 1;
+		}
+	    }
+	    else if (!strcmp(argv[ii], "-o")) {
+		if (ii < argc - 1) {
+		    strcpy(out_filename, argv[ii+1]);
+		    ii += 1;
+		}
+	    }
+	}
+	else {
+	  strcpy(tr_filename, argv[ii]);
+	}
+    }
+
+    if(!tr_filename[0]) {
+        die_usage();
+    }
+    if(NUM_CLUSTERS < 1 || NUM_CLUSTERS > MAX_CLUSTERS || INTERVAL_INSTS == 0) {
+        die_message("Bad -k or -interval");
+    }
+
+    sprintf(cmd_string,"gunzip -c %s", tr_filename);
+    if ((tr_file = popen(cmd_string, "r")) == NULL){
+        die_message("Unable to open the trace file with gzip option");
+    }
+
+    profile(tr_file);
+    pclose(tr_file);
+
+    if(num_intervals == 0) {
+        die_message("Trace is shorter than one interval");
+    }
+
+    uint32_t k = NUM_CLUSTERS;
+    if(k > num_intervals) {
+        k = num_intervals;
+    }
+
+    uint32_t *assign  = (uint32_t *) calloc (num_intervals, sizeof(uint32_t));
+    double   *centers = (double *) calloc (k*BBV_DIMS, sizeof(double));
+    kmeans(k, assign, centers);
+
+    // ------- Representative (closest to centroid) per cluster --------
+    uint64_t rep[MAX_CLUSTERS];
+    double   rep_d[MAX_CLUSTERS];
+    uint64_t size[MAX_CLUSTERS] = {0};
+    for(uint32_t cc = 0; cc < k; cc++) {
+        rep_d[cc] = -1;
+    }
+    for(uint64_t jj = 0; jj < num_intervals; jj++) {
+        uint32_t cc = assign[jj];
+        double d = dist2(&bbv[jj*BBV_DIMS], &centers[cc*BBV_DIMS]);
+        size[cc]++;
+        if(rep_d[cc] < 0 || d < rep_d[cc]) {
+            rep_d[cc] = d;
+            rep[cc] = jj;
+        }
+    }
+
+    // ------- Emit points in trace order -------------------------------
+    if(out_filename[0] && (out_file = fopen(out_filename, "w")) == NULL) {
+        die_message("Unable to open the output file");
+    }
+    fprintf(out_file, "# bbvprof %s: %llu intervals, k %u\n", tr_filename,
+            (unsigned long long)num_intervals, k);
+    fprintf(out_file, "interval %llu\n", (unsigned long long)INTERVAL_INSTS);
+    fprintf(out_file, "intervals %llu\n", (unsigned long long)num_intervals);
+
+    bool emitted[MAX_CLUSTERS] = {false};
+    for(uint32_t nn = 0; nn < k; nn++) {
+        int first = -1;
+        for(uint32_t cc = 0; cc < k; cc++) {
+            if(size[cc] && !emitted[cc] && (first < 0 || rep[cc] < rep[first])) {
+                first = cc;
+            }
+        }
+        if(first < 0) {
+            break;
+        }
+        emitted[first] = true;
+        fprintf(out_file, "%llu %.6f\n", (unsigned long long)rep[first],
+                (double)size[first]/(double)num_intervals);
+    }
+
+    if(out_file != stdout) {
+        fclose(out_file);
+    }
+    free(assign);
+    free(centers);
+    free(bbv);
+    return 0;
+}
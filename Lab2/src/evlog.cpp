@@ -0,0 +1,172 @@
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include "evlog.h"
+
+/////////////////////////////////////////////////////////////
+// Varint helpers (LEB128, zigzag for signed deltas)
+/////////////////////////////////////////////////////////////
+
+static inline uint32_t put_varint(uint8_t *buf, uint64_t v){
+  uint32_t n = 0;
+  while(v >= 0x80) {
+    buf[n++] = (uint8_t)(v | 0x80);
+    v >>= 7;
+  }
+  buf[n++] = (uint8_t)v;
+  return n;
+}
+
+static inline uint32_t get_varint(const uint8_t *buf, uint64_t *v){
+  uint32_t n = 0;
+  int shift = 0;
+  *v = 0;
+  while(buf[n] & 0x80) {
+    *v |= (uint64_t)(buf[n++] & 0x7f) << shift;
+    shift += 7;
+  }
+  *v |= (uint64_t)buf[n++] << shift;
+  return n;
+}
+
+static inline uint64_t zigzag(int64_t v){
+  return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static inline int64_t unzigzag(uint64_t v){
+  return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+/////////////////////////////////////////////////////////////
+// Flush (write mode) or refill (read mode) the buffer
+/////////////////////////////////////////////////////////////
+
+static void EVLOG_flush(EVLOG *t){
+  if(t->pos) {
+    fwrite(t->buf, 1, t->pos, t->fp);
+    t->pos = 0;
+  }
+}
+
+static void EVLOG_refill(EVLOG *t){
+  uint32_t left = t->len - t->pos;
+  memmove(t->buf, t->buf + t->pos, left);
+  t->len = left + fread(t->buf + left, 1, EVLOG_BUF_SIZE - left, t->fp);
+  t->pos = 0;
+}
+
+/////////////////////////////////////////////////////////////
+// Open a log for writing, stage_chars names each stage
+/////////////////////////////////////////////////////////////
+
+EVLOG* EVLOG_open_write(const char *fname, const char *stage_chars){
+  EVLOG *t = (EVLOG *) calloc (1, sizeof (EVLOG));
+  if((t->fp = fopen(fname, "wb")) == NULL) {
+    free(t);
+    return NULL;
+  }
+  t->is_write = true;
+
+  memcpy(t->header.magic, "EVLG", 4);
+  t->header.version = EVLOG_VERSION;
+  assert(strlen(stage_chars) == EVLOG_NUM_STAGES);
+  memcpy(t->header.stage_char, stage_chars, EVLOG_NUM_STAGES);
+  fwrite(&t->header, sizeof(EVLOG_Header), 1, t->fp);
+  return t;
+}
+
+/////////////////////////////////////////////////////////////
+// Open an existing log for reading, NULL if not a log
+/////////////////////////////////////////////////////////////
+
+EVLOG* EVLOG_open_read(const char *fname){
+  EVLOG *t = (EVLOG *) calloc (1, sizeof (EVLOG));
+  if((t->fp = fopen(fname, "rb")) == NULL) {
+    free(t);
+    return NULL;
+  }
+
+  if( (fread(&t->header, sizeof(EVLOG_Header), 1, t->fp) != 1) ||
+      memcmp(t->header.magic, "EVLG", 4) ||
+      (t->header.version != EVLOG_VERSION) ) {
+    fclose(t->fp);
+    free(t);
+    return NULL;
+  }
+  return t;
+}
+
+/////////////////////////////////////////////////////////////
+// Append one record (stage cycles must be non-decreasing)
+/////////////////////////////////////////////////////////////
+
+void EVLOG_write(EVLOG *t, EVLOG_Rec *rec){
+  assert(t->is_write);
+  if(t->pos > EVLOG_BUF_SIZE - EVLOG_MAX_REC) {
+    EVLOG_flush(t);
+  }
+
+  uint8_t *b = t->buf + t->pos;
+  uint32_t n = 0;
+  n += put_varint(b+n, zigzag((int64_t)(rec->inst_num - t->last_inst_num)));
+  n += put_varint(b+n, zigzag((int64_t)(rec->cycle[0] - t->last_cycle)));
+  b[n++] = rec->op_type;
+  for(int ii = 1; ii < EVLOG_NUM_STAGES; ii++) {
+    assert(rec->cycle[ii] >= rec->cycle[ii-1]);
+    n += put_varint(b+n, rec->cycle[ii] - rec->cycle[ii-1]);
+  }
+
+  t->pos += n;
+  t->last_inst_num = rec->inst_num;
+  t->last_cycle = rec->cycle[0];
+  t->num_recs++;
+}
+
+/////////////////////////////////////////////////////////////
+// Decode the next record, false at end of log
+/////////////////////////////////////////////////////////////
+
+bool EVLOG_read(EVLOG *t, EVLOG_Rec *rec){
+  assert(!t->is_write);
+  if(t->len - t->pos < EVLOG_MAX_REC) {
+    EVLOG_refill(t);
+  }
+  if(t->pos >= t->len) {
+    return false;
+  }
+
+  const uint8_t *b = t->buf + t->pos;
+  uint32_t n = 0;
+  uint64_t v;
+  n += get_varint(b+n, &v);
+  rec->inst_num = t->last_inst_num + unzigzag(v);
+  n += get_varint(b+n, &v);
+  rec->cycle[0] = t->last_cycle + unzigzag(v);
+  rec->op_type = b[n++];
+  for(int ii = 1; ii < EVLOG_NUM_STAGES; ii++) {
+    n += get_varint(b+n, &v);
+    rec->cycle[ii] = rec->cycle[ii-1] + v;
+  }
+
+  t->pos += n;
+  t->last_inst_num = rec->inst_num;
+  t->last_cycle = rec->cycle[0];
+  t->num_recs++;
+  return true;
+}
+
+/////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////
+
+void EVLOG_close(EVLOG *t){
+  if(t->is_write) {
+    EVLOG_flush(t);
+  }
+  fclose(t->fp);
+  free(t);
+}
+
+/////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////
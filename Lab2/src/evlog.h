@@ -0,0 +1,65 @@
+#ifndef _EVLOG_H_
+#define _EVLOG_H_
+#include <inttypes.h>
+#include <stdio.h>
+#include <cstdlib>
+
+/////////////////////////////////////////////////////////////
+// Binary pipeline event log: one record per committed inst
+// with the cycle it entered each of EVLOG_NUM_STAGES stages.
+//
+// File layout: EVLOG_Header, then variable length records:
+//   zigzag varint  inst_num delta (from previous record)
+//   zigzag varint  stage 0 cycle delta (from previous record)
+//   byte           op_type
+//   varint         stage i cycle - stage i-1 cycle, i=1..N-1
+/////////////////////////////////////////////////////////////
+
+#define EVLOG_NUM_STAGES 5
+#define EVLOG_VERSION    1
+#define EVLOG_BUF_SIZE   (1<<20)
+#define EVLOG_MAX_REC    ((2+EVLOG_NUM_STAGES)*10) // worst case bytes per record
+
+typedef struct EVLOG_Header_Struct {
+  char     magic[4];                     // "EVLG"
+  uint32_t version;
+  char     stage_char[EVLOG_NUM_STAGES]; // diagram letter per stage
+  char     pad[3];
+} EVLOG_Header;
+
+typedef struct EVLOG_Rec_Struct {
+  uint64_t inst_num;
+  uint8_t  op_type;
+  uint64_t cycle[EVLOG_NUM_STAGES];
+} EVLOG_Rec;
+
+/////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////
+
+typedef struct EVLOG {
+  FILE        *fp;
+  bool         is_write;
+  EVLOG_Header header;
+
+  uint8_t      buf[EVLOG_BUF_SIZE];
+  uint32_t     pos;   // next byte to encode/decode
+  uint32_t     len;   // valid bytes in buf (read mode)
+
+  uint64_t     last_inst_num;
+  uint64_t     last_cycle;
+  uint64_t     num_recs;
+} EVLOG;
+
+/////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////
+
+EVLOG* EVLOG_open_write(const char *fname, const char *stage_chars);
+EVLOG* EVLOG_open_read(const char *fname);
+void   EVLOG_write(EVLOG *t, EVLOG_Rec *rec);
+bool   EVLOG_read(EVLOG *t, EVLOG_Rec *rec);
+void   EVLOG_close(EVLOG *t);
+
+/////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////
+
+#endif
@@ -0,0 +1,139 @@
+/********************************************************************
+ * File         : evview.cpp
+ * Description  : Render pipeline diagrams from a binary event log
+ *                written by "sim -evlog <file>"
+ *********************************************************************/
+
+#include <iostream>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include "evlog.h"
+#include "trace.h"
+
+#define MAX_VIEW_INSTS  4096
+#define MAX_VIEW_CYCLES 160
+
+
+/*********************************************************************
+ * Global Scope Functions
+ *********************************************************************/
+
+void die_message(const char *msg) {
+    printf("Error! %s. Exiting...\n", msg);
+    exit(1);
+}
+
+void die_usage() {
+    printf("Usage : evview <event_log> [first_inst] [num_inst] \n\n");
+    printf("Prints one pipeline diagram row per instruction in the window\n");
+    printf("   first_inst   First inst_num to show (Default: 1)\n");
+    printf("   num_inst     Number of instructions to show (Default: 32, Max: %d)\n", MAX_VIEW_INSTS);
+    exit(0);
+}
+
+static const char *op_name(uint8_t op_type) {
+    switch(op_type) {
+    case OP_ALU:   return "ALU";
+    case OP_LD:    return "LD ";
+    case OP_ST:    return "ST ";
+    case OP_CBR:   return "CBR";
+    default:       return "OTH";
+    }
+}
+
+EVLOG_Rec window[MAX_VIEW_INSTS];
+
+/*********************************************************************
+ * Main
+ *********************************************************************/
+
+int main(int argc, char *argv[])
+{
+    uint64_t first_inst = 1;
+    uint64_t num_inst = 32;
+
+    if(argc < 2 || !strcmp(argv[1], "-h") || !strcmp(argv[1], "-help")) {
+        die_usage();
+    }
+    if(argc > 2) {
+        first_inst = strtoull(argv[2], NULL, 10);
+    }
+    if(argc > 3) {
+        num_inst = strtoull(argv[3], NULL, 10);
+    }
+    if(num_inst > MAX_VIEW_INSTS) {
+        num_inst = MAX_VIEW_INSTS;
+    }
+
+    EVLOG *log = EVLOG_open_read(argv[1]);
+    if(log == NULL) {
+        die_message("Unable to open event log");
+    }
+
+    // ------- Collect the window (records are in commit order) ---------
+    uint64_t count = 0;
+    uint64_t base_cycle = (uint64_t)-1;
+    EVLOG_Rec rec;
+    while(EVLOG_read(log, &rec)) {
+        if(rec.inst_num < first_inst || rec.inst_num >= first_inst + num_inst) {
+            if(count == num_inst) {
+                break;
+            }
+            continue;
+        }
+        window[rec.inst_num - first_inst] = rec;
+        window[rec.inst_num - first_inst].op_type |= 0x80; // mark present
+        if(rec.cycle[0] < base_cycle) {
+            base_cycle = rec.cycle[0];
+        }
+        count++;
+    }
+
+    if(count == 0) {
+        EVLOG_close(log);
+        die_message("No instructions in the requested window");
+    }
+
+    // ------- Print one row per instruction ----------------------------
+    printf("Stages:");
+    for(int ss = 0; ss < EVLOG_NUM_STAGES; ss++) {
+        printf(" %c", log->header.stage_char[ss]);
+    }
+    printf("   (column 0 is cycle %llu)\n\n", (unsigned long long)base_cycle);
+
+    char row[MAX_VIEW_CYCLES+2];
+    for(uint64_t ii = 0; ii < num_inst; ii++) {
+        EVLOG_Rec *r = &window[ii];
+        if(!(r->op_type & 0x80)) {
+            continue;
+        }
+
+        memset(row, ' ', sizeof(row));
+        uint64_t start = r->cycle[0] - base_cycle;
+        uint64_t end   = r->cycle[EVLOG_NUM_STAGES-1] - base_cycle;
+        for(uint64_t cc = start; cc <= end && cc < MAX_VIEW_CYCLES; cc++) {
+            row[cc] = '.';
+        }
+        // later stages win when two happen in the same cycle
+        for(int ss = 0; ss < EVLOG_NUM_STAGES; ss++) {
+            uint64_t cc = r->cycle[ss] - base_cycle;
+            if(cc < MAX_VIEW_CYCLES) {
+                row[cc] = log->header.stage_char[ss];
+            }
+        }
+        int last = (end < MAX_VIEW_CYCLES) ? (int)end : MAX_VIEW_CYCLES;
+        if(end >= MAX_VIEW_CYCLES) {
+            row[last] = '>';
+        }
+        row[last+1] = '\0';
+
+        printf("%10llu %s |%s\n", (unsigned long long)r->inst_num,
+               op_name(r->op_type & 0x7f), row);
+    }
+
+    EVLOG_close(log);
+    return 0;
+}
@@ -25,6 +25,10 @@ void pipe_get_fetch_op(Pipeline *p, Pipeline_Latch* fetch_op){
     if( bytes_read < sizeof(Trace_Rec)) {
       fetch_op->valid=false;
       p->halt_op_id=p->op_id_tracker;
+      // trace ran out right after a fast-forward, nothing left to retire
+      if(p->stat_retired_inst == p->op_id_tracker) {
+        p->halt=true;
+      }
       return;
     }
 
@@ -345,6 +349,10 @@ void pipe_cycle_WB(Pipeline *p){
       p->stat_retired_inst++;
       //printf("retired instructions: %lu\n", p->stat_retired_inst);
 
+      if(p->evlog){
+        pipe_log_retire(p, &p->pipe_latch[MEM_LATCH][ii]);
+      }
+
       if(p->pipe_latch[MEM_LATCH][ii].op_id >= p->halt_op_id){
 	      p->halt=true;
       }
@@ -369,6 +377,7 @@ void pipe_cycle_MEM(Pipeline *p){
     //print_instruction(&p->pipe_latch[EX_LATCH][ii]);
 
     p->pipe_latch[MEM_LATCH][ii]=p->pipe_latch[EX_LATCH][ii];
+    p->pipe_latch[MEM_LATCH][ii].mem_cycle = p->stat_num_cycle;
     p->pipe_latch[EX_LATCH][ii].valid = 0;
 
     if(BPRED_POLICY){
@@ -396,6 +405,7 @@ void pipe_cycle_EX(Pipeline *p){
 
     else {
       p->pipe_latch[EX_LATCH][ii]=p->pipe_latch[ID_LATCH][ii];
+      p->pipe_latch[EX_LATCH][ii].ex_cycle = p->stat_num_cycle;
       p->pipe_latch[ID_LATCH][ii].valid = 0;
     }
 
@@ -421,6 +431,7 @@ void pipe_cycle_ID(Pipeline *p){
       }
       if (pass) {
         p->pipe_latch[ID_LATCH][ii]=p->pipe_latch[FE_LATCH][ii];
+        p->pipe_latch[ID_LATCH][ii].id_cycle = p->stat_num_cycle;
         p->pipe_latch[FE_LATCH][ii].valid = 0;
       }
     }
@@ -450,11 +461,13 @@ void pipe_cycle_FE(Pipeline *p) {
 
   for(ii=0; ii<PIPE_WIDTH; ii++){
 
-    if (!p->pipe_latch[FE_LATCH][ii].valid && !p->fetch_cbr_stall) {
+    if (!p->pipe_latch[FE_LATCH][ii].valid && !p->fetch_cbr_stall && !p->fetch_stop) {
       
       pipe_get_fetch_op(p, &fetch_op); 
+      fetch_op.fe_cycle = p->stat_num_cycle;
 
-      if(BPRED_POLICY){
+      // at end of trace fetch_op holds no record, do not predict it
+      if(BPRED_POLICY && fetch_op.valid){
         pipe_check_bpred(p, &fetch_op);
       }
       
@@ -505,3 +518,59 @@ void pipe_check_bpred(Pipeline *p, Pipeline_Latch *fetch_op) {
 
 //--------------------------------------------------------------------//
 
+
+void pipe_log_retire(Pipeline *p, Pipeline_Latch *op) {
+  EVLOG_Rec rec;
+  rec.inst_num = op->op_id;
+  rec.op_type  = op->tr_entry.op_type;
+  rec.cycle[0] = op->fe_cycle;
+  rec.cycle[1] = op->id_cycle;
+  rec.cycle[2] = op->ex_cycle;
+  rec.cycle[3] = op->mem_cycle;
+  rec.cycle[4] = p->stat_num_cycle;
+  EVLOG_write(p->evlog, &rec);
+}
+
+
+//--------------------------------------------------------------------//
+
+
+
+bool pipe_is_drained(Pipeline *p) {
+  for(int ii=0; ii<PIPE_WIDTH; ii++){
+    for(int jj=0; jj<NUM_LATCH_TYPES; jj++){
+      if(p->pipe_latch[jj][ii].valid){
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+
+//--------------------------------------------------------------------//
+
+// Read past num trace records without timing them. The branch predictor
+// is still trained so it is warm when detailed simulation resumes.
+uint64_t pipe_skip_insts(Pipeline *p, uint64_t num) {
+  Trace_Rec tr_entry;
+  uint64_t done = 0;
+
+  assert(pipe_is_drained(p));
+  while(done < num) {
+    if(fread(&tr_entry, 1, sizeof(Trace_Rec), p->tr_file) < sizeof(Trace_Rec)) {
+      p->halt = true;
+      break;
+    }
+    if(BPRED_POLICY && tr_entry.op_type == OP_CBR){
+      bool pred = p->b_pred->GetPrediction(tr_entry.inst_addr);
+      p->b_pred->UpdatePredictor(tr_entry.inst_addr, tr_entry.br_dir, pred);
+    }
+    done++;
+  }
+  p->stat_skipped_inst += done;
+  return done;
+}
+
+
+//--------------------------------------------------------------------//
@@ -7,6 +7,7 @@
 
 #include "trace.h"
 #include "bpred.h"
+#include "evlog.h"
 
 #define MAX_PIPE_WIDTH 8
 
@@ -23,6 +24,12 @@ typedef struct Pipeline_Latch_Struct {
   bool stall;
   Trace_Rec tr_entry;
   bool is_mispred_cbr; 
+
+  // cycle the op entered each latch (for the event log)
+  uint64_t fe_cycle;
+  uint64_t id_cycle;
+  uint64_t ex_cycle;
+  uint64_t mem_cycle;
 }Pipeline_Latch;
 
 typedef enum Latch_Type_ENUM {
@@ -38,16 +45,19 @@ typedef struct Pipeline {
   FILE *tr_file;
   Pipeline_Latch  pipe_latch[NUM_LATCH_TYPES][MAX_PIPE_WIDTH];// Pipeline Latches
   BPRED *b_pred;
+  EVLOG *evlog;                   // optional event log, NULL when off
   
   uint64_t op_id_tracker;         // a sequence number for OPs to track
   uint64_t halt_op_id;            // OpID of last inst in Trace
   bool halt;                      // Pipeline Done Flag
 
   bool fetch_cbr_stall;           // fetch stalled due to brach misprediction
+  bool fetch_stop;                // stop fetching new ops (to drain for simpoints)
   
   /* Statistics: students need to update these counters*/
   uint64_t stat_retired_inst;         // Total Commited Instructions
   uint64_t stat_num_cycle;            // Total Cycles
+  uint64_t stat_skipped_inst;         // Ops fast-forwarded without timing
 }Pipeline;
 
 Pipeline* pipe_init(FILE *tr_file);   // Allocate Structures
@@ -60,6 +70,10 @@ void pipe_cycle_MEM(Pipeline *p);                   // MEM Stage
 void pipe_cycle_WB(Pipeline *p);                    // WB Stage
 
 void pipe_check_bpred(Pipeline *p, Pipeline_Latch *fetch_op); // Branch Prediction Check
+void pipe_log_retire(Pipeline *p, Pipeline_Latch *op);         // Event Log Record
+
+bool     pipe_is_drained(Pipeline *p);                // no op in any latch
+uint64_t pipe_skip_insts(Pipeline *p, uint64_t num);  // functional fast-forward
 
 void pipe_print_state(Pipeline *p);                 // Print Pipeline Latches
 
@@ -12,6 +12,7 @@
 #include "pipeline.h"
 
 #define HEARTBEAT_CYCLES 10000
+#define MAX_SIMPOINTS    64
 
 
 /*********************************************************************
@@ -31,12 +32,17 @@ void die_usage() {
     printf("   -enablememfwd         Enable forwarding from MEM stage (Default: off)\n");
     printf("   -enableexefwd         Enable forwarding from EXE stage (Default: off)\n");
     printf("   -bpredpolicy <num>    Set branch predictor  [0:Perf 1:Taken 2:Gshare]\n");
+    printf("   -evlog       <file>   Write a binary pipeline event log (view with evview)\n");
+    printf("   -simpoints   <file>   Simulate only the weighted regions picked by bbvprof\n");
+    printf("   -simpointwarm <num>   Detailed warm-up insts before each region (Default: 2000)\n");
 }
 
 void check_heartbeat(void);
 
 void print_stats(void);
 
+void run_simpoints(const char *fname);
+
 
 /*********************************************************************
  * Params and Globals
@@ -45,6 +51,14 @@ uint32_t  PIPE_WIDTH=1;
 uint32_t  ENABLE_MEM_FWD=0;
 uint32_t  ENABLE_EXE_FWD=0;
 uint32_t  BPRED_POLICY=0; // 0:Perf 1:AlwaysTaken 2:Gshare
+uint64_t  SIMPOINT_WARM=2000;
+
+// Simulation point mode results, one entry per simulated region
+uint32_t  simpoint_count;
+uint64_t  simpoint_total_inst;   // trace length seen by bbvprof
+double    simpoint_weight[MAX_SIMPOINTS];
+uint64_t  simpoint_inst[MAX_SIMPOINTS];
+uint64_t  simpoint_cycle[MAX_SIMPOINTS];
 
 Pipeline *pipeline;
 /*********************************************************************
@@ -57,6 +71,8 @@ int main(int argc, char *argv[])
 
     FILE *tr_file;
     char tr_filename[1024];
+    char evlog_filename[1024] = "";
+    char simpoint_filename[1024] = "";
     char cmd_string[256];
     
     if(argc < 1) {
@@ -94,6 +110,27 @@ int main(int argc, char *argv[])
 	    else if (!strcmp(argv[ii], "-enableexefwd")) {
 	      ENABLE_EXE_FWD = 1;
 	    }
+
+	    else if (!strcmp(argv[ii], "-simpoints")) {
+		if (ii < argc - 1) {		  
+		    strcpy(simpoint_filename, argv[ii+1]);
+		    ii += 1;
+		}
+	    }
+
+	    else if (!strcmp(argv[ii], "-simpointwarm")) {
+		if (ii < argc - 1) {		  
+		    SIMPOINT_WARM = atoll(argv[ii+1]);
+		    ii += 1;
+		}
+	    }
+
+	    else if (!strcmp(argv[ii], "-evlog")) {
+		if (ii < argc - 1) {		  
+		    strcpy(evlog_filename, argv[ii+1]);
+		    ii += 1;
+		}
+	    }
 	}
 	else {
 	  strcpy(tr_filename, argv[ii]);
@@ -113,18 +150,137 @@ int main(int argc, char *argv[])
   // ------- Pipeline Initialization & Execution ----------------------
 
      pipeline = pipe_init(tr_file); 
+
+     if(evlog_filename[0]) {
+       // Fetch, Decode, eXecute, Memory, Writeback
+       if((pipeline->evlog = EVLOG_open_write(evlog_filename, "FDXMW")) == NULL) {
+         die_message("Unable to open the event log for writing");
+       }
+     }
     
-    while(!pipeline->halt) {
-      pipe_cycle(pipeline);
-      check_heartbeat();
+    if(simpoint_filename[0]) {
+      run_simpoints(simpoint_filename);
+    }
+    else {
+      while(!pipeline->halt) {
+        pipe_cycle(pipeline);
+        check_heartbeat();
+      }
     }
 
   // ------- Print Statistics------------------------------------------
     print_stats();
+    if(pipeline->evlog) {
+      EVLOG_close(pipeline->evlog);
+    }
     fclose(tr_file);
     return 0;
 }
 
+/*********************************************************************
+ * Simulation Points (SimPoint style)
+ *
+ * The points file from bbvprof lists "interval <insts>", "intervals
+ * <count>" and then one "<interval index> <weight>" line per region, in
+ * trace order. Between regions the pipeline is drained and the trace is
+ * fast-forwarded (training only the branch predictor). Each region gets
+ * SIMPOINT_WARM insts of detailed warm-up and is measured for one
+ * interval; the whole-trace CPI is the weighted sum of region CPIs.
+ *********************************************************************/
+
+void run_until_retired(uint64_t target) {
+    while(!pipeline->halt && pipeline->stat_retired_inst < target) {
+      pipe_cycle(pipeline);
+      check_heartbeat();
+    }
+}
+
+void run_simpoints(const char *fname) {
+    FILE *fp = fopen(fname, "r");
+    char line[256];
+    uint64_t interval = 0;
+    uint64_t idx[MAX_SIMPOINTS];
+    double   weight[MAX_SIMPOINTS];
+    uint32_t num_points = 0;
+
+    if(fp == NULL) {
+      die_message("Unable to open the simpoints file");
+    }
+    while(fgets(line, sizeof(line), fp)) {
+      unsigned long long a;
+      double w;
+      if(line[0] == '#') {
+        continue;
+      }
+      if(sscanf(line, "interval %llu", &a) == 1) {
+        interval = a;
+      }
+      else if(sscanf(line, "intervals %llu", &a) == 1) {
+        simpoint_total_inst = a;
+      }
+      else if(sscanf(line, "%llu %lf", &a, &w) == 2) {
+        if(num_points == MAX_SIMPOINTS) {
+          die_message("Too many simulation points");
+        }
+        if(num_points && a <= idx[num_points-1]) {
+          die_message("Simulation points must be in trace order");
+        }
+        idx[num_points] = a;
+        weight[num_points] = w;
+        num_points++;
+      }
+    }
+    fclose(fp);
+    if(interval == 0 || num_points == 0) {
+      die_message("No simulation points in the simpoints file");
+    }
+    simpoint_total_inst *= interval;
+
+    for(uint32_t pp = 0; pp < num_points && !pipeline->halt; pp++) {
+      uint64_t start = idx[pp]*interval;
+      uint64_t warm_start = (start > SIMPOINT_WARM) ? start - SIMPOINT_WARM : 0;
+      uint64_t trace_pos = pipeline->op_id_tracker + pipeline->stat_skipped_inst;
+
+      // regions close to the last one just keep running in detail
+      if(warm_start > trace_pos) {
+        pipeline->fetch_stop = true;
+        while(!pipeline->halt && !pipe_is_drained(pipeline)) {
+          pipe_cycle(pipeline);
+          check_heartbeat();
+        }
+        if(pipeline->halt) {
+          break;
+        }
+        trace_pos = pipeline->op_id_tracker + pipeline->stat_skipped_inst;
+        if(warm_start > trace_pos) {
+          pipe_skip_insts(pipeline, warm_start - trace_pos);
+        }
+        pipeline->fetch_stop = false;
+      }
+      uint64_t commit_pos = pipeline->stat_retired_inst + pipeline->stat_skipped_inst;
+      if(start > commit_pos) {
+        run_until_retired(pipeline->stat_retired_inst + (start - commit_pos));
+      }
+
+      uint64_t inst0  = pipeline->stat_retired_inst;
+      uint64_t cycle0 = pipeline->stat_num_cycle;
+      run_until_retired(inst0 + interval);
+
+      uint64_t unit_inst = pipeline->stat_retired_inst - inst0;
+      if(unit_inst < interval/2) { // trace ended inside the region
+        continue;
+      }
+      simpoint_weight[simpoint_count] = weight[pp];
+      simpoint_inst[simpoint_count]   = unit_inst;
+      simpoint_cycle[simpoint_count]  = pipeline->stat_num_cycle - cycle0;
+      simpoint_count++;
+    }
+
+    if(simpoint_count == 0) {
+      die_message("No simulation point could be simulated");
+    }
+}
+
 /*********************************************************************
  * Print Statistics 
  *********************************************************************/
@@ -136,6 +292,19 @@ void print_stats(void) {
     uint64_t stat_num_cycle      = pipeline->stat_num_cycle;
     double cpi = (double)(stat_num_cycle)/(double)(stat_num_inst);
 
+    if(simpoint_count) {
+      // weights are renormalized over the regions actually simulated
+      double wsum = 0;
+      cpi = 0;
+      for(uint32_t pp = 0; pp < simpoint_count; pp++) {
+        wsum += simpoint_weight[pp];
+        cpi  += simpoint_weight[pp]*(double)simpoint_cycle[pp]/(double)simpoint_inst[pp];
+      }
+      cpi /= wsum;
+      stat_num_inst  = simpoint_total_inst;
+      stat_num_cycle = (uint64_t)(cpi*(double)stat_num_inst);
+    }
+
     printf("\n\n");
   
     printf("\n%s_NUM_INST           \t : %10u" , header, (uint32_t)stat_num_inst)  ;
@@ -147,6 +316,15 @@ void print_stats(void) {
     printf("\n%s_BPRED_MISPRED      \t : %10u" , header, (uint32_t)pipeline->b_pred->stat_num_mispred)  ;
     printf("\n%s_MISPRED_RATE       \t : %10.3f" , header, 100.0*(double)(pipeline->b_pred->stat_num_mispred)/(double)(pipeline->b_pred->stat_num_branches));
     }
+
+    if(simpoint_count) {
+    printf("\n%s_SIMPOINT_REGIONS   \t : %10u" , header, simpoint_count);
+    printf("\n%s_SIMPOINT_DETAIL_INST\t : %10u" , header, (uint32_t)pipeline->stat_retired_inst);
+    for(uint32_t pp = 0; pp < simpoint_count; pp++) {
+      printf("\n%s_SIMPOINT_%-10u\t : %10.3f (weight %.4f)" , header, pp,
+             (double)simpoint_cycle[pp]/(double)simpoint_inst[pp], simpoint_weight[pp]);
+    }
+    }
     
     printf("\n\n");
 }
@@ -69,10 +69,22 @@
 
 
 
+########## ---------------  W.1 (small REST) ---------------- ################
+# REST fills long before the ROB, so the CPI stack shows DISPATCH and
+# HEAD_LD_FULL slots
+
+../src.BC/sim -pipewidth 2 -robsize 16 -restsize 2 ../traces/bzip2.ptr.gz > ../results/W1.bzip2.res
+../src.BC/sim -pipewidth 2 -robsize 16 -restsize 2 ../traces/gcc.ptr.gz > ../results/W1.gcc.res
+../src.BC/sim -pipewidth 2 -robsize 16 -restsize 2 ../traces/libq.ptr.gz > ../results/W1.libq.res
+../src.BC/sim -pipewidth 2 -robsize 16 -restsize 2 ../traces/mcf.ptr.gz > ../results/W1.mcf.res
+
+
+
 ########## ---------------  GenReport ---------------- ################
 
-grep LAB3_CPI ../results/B?.*.res > report.txt
-grep LAB3_CPI ../results/C?.*.res >> report.txt
+grep "LAB3_CPI " ../results/B?.*.res > report.txt
+grep "LAB3_CPI " ../results/C?.*.res >> report.txt
+grep -E "LAB3_CPI(_DISPATCH|_HEAD_LD_FULL)? " ../results/W?.*.res >> report.txt
 
 
 ######### ------- Goodbye -------- ##################
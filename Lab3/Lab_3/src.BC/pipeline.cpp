@@ -36,6 +36,11 @@ void pipe_fetch_inst(Pipeline *p, Pipe_Latch* fe_latch){
         fe_latch->inst.src1_reg = -1;
         fe_latch->inst.inst_num=-1;
         fe_latch->inst.op_type=4;
+        // a fast-forward can end right at the end of the trace, with
+        // every fetched inst already retired: nothing left to commit
+        if(p->stat_retired_inst == p->inst_num_tracker){
+          p->halt=true;
+        }
         return;
       }
 
@@ -56,6 +61,7 @@ void pipe_fetch_inst(Pipeline *p, Pipe_Latch* fe_latch){
       fetch_inst->src1_ready=false;
       fetch_inst->src2_ready=false;
       fetch_inst->exe_wait_cycles=0;
+      fetch_inst->fetch_cycle=p->stat_num_cycle;
     } else {
       fe_latch->valid = false;
     }
@@ -153,6 +159,50 @@ void pipe_print_state(Pipeline *p){
 }
 
 
+/**********************************************************************
+ * Sampling support: check for an empty pipeline, and skip trace records
+ **********************************************************************/
+
+bool pipe_is_drained(Pipeline *p){
+    int ii;
+    for(ii = 0; ii < PIPE_WIDTH; ii++) {
+      if(p->FE_latch[ii].valid || p->ID_latch[ii].valid || p->SC_latch[ii].valid) {
+        return false;
+      }
+    }
+    for(ii = 0; ii < MAX_EXEQ_ENTRIES; ii++) {
+      if(p->pipe_EXEQ->EXEQ_Entries[ii].valid) {
+        return false;
+      }
+    }
+    return !p->pipe_ROB->ROB_Entries[p->pipe_ROB->head_ptr].valid;
+}
+
+// Advance the trace by num records without timing them. Only call on a
+// drained pipeline; inst_num keeps counting the detailed insts only.
+uint64_t pipe_skip_insts(Pipeline *p, uint64_t num){
+    Trace_Rec trace[256];
+    uint64_t done = 0;
+    assert(pipe_is_drained(p));
+
+    while(done < num) {
+      uint64_t chunk = num - done;
+      if(chunk > 256) {
+        chunk = 256;
+      }
+      uint64_t got = fread(trace, sizeof(Trace_Rec), chunk, p->tr_file);
+      done += got;
+      if(got < chunk) {
+        p->halt = true;  // end of trace, nothing is in flight
+        break;
+      }
+    }
+
+    p->stat_skipped_inst += done;
+    return done;
+}
+
+
 /**********************************************************************
  * Pipeline Main Function: Every cycle, cycle the stage 
  **********************************************************************/
@@ -177,6 +227,10 @@ void pipe_cycle_fetch(Pipeline *p){
   int ii = 0;
   Pipe_Latch fetch_latch;
 
+  if(p->fetch_stop) {
+    return;
+  }
+
   for(ii=0; ii<PIPE_WIDTH; ii++) {
     if((p->FE_latch[ii].stall) || (p->FE_latch[ii].valid)) {   // Stall 
         continue;
@@ -292,22 +346,33 @@ uint32_t oldest_id(Pipeline *p)
 
 void pipe_cycle_rename(Pipeline *p){
   int i;
+  p->disp_blocked = false;
   for(i=0; i<PIPE_WIDTH; i++) {
 
-    // these should be equal
-    assert( ROB_check_space( p->pipe_ROB ) == REST_check_space( p->pipe_REST ) );
-
     // get the instruction from id latch.
-    // probably need to check for stalling 
-    // this is really just if we are full or not.
+    // ROB and REST are sized independently, so we need space in both.
 
     // problem is that we can take only A. Then B is youngest. C comes in at top pipe and is treated as older.
     int min = oldest_id(p);
-    if ( !( (min >= 0) && p->ID_latch[min].valid && ROB_check_space(p->pipe_ROB) ) ) { return; }
+    if ( !( (min >= 0) && p->ID_latch[min].valid ) ) {
+      p->stat_disp_stall_rename++;
+      return;
+    }
+    if ( !ROB_check_space(p->pipe_ROB) ) {
+      p->stat_disp_stall_rob++;
+      p->disp_blocked = true;
+      return;
+    }
+    if ( !REST_check_space(p->pipe_REST) ) {
+      p->stat_disp_stall_rest++;
+      p->disp_blocked = true;
+      return;
+    }
     
     // this was never set to min...
     // it was left as "i"
     Inst_Info id_inst = p->ID_latch[min].inst;
+    id_inst.rename_cycle = p->stat_num_cycle;
 
 /*
     printf("cycle #%lu\n", p->stat_num_cycle);
@@ -362,15 +427,11 @@ void pipe_cycle_rename(Pipeline *p){
     p->ID_latch[min].valid = false;
 
     // todo: Find space in ROB and set drtag as such if successful
-    if ( ROB_check_space( p->pipe_ROB ) ) {
-      int tag = ROB_insert( p->pipe_ROB, id_inst );
-      id_inst.dr_tag = tag;
-    }
+    int tag = ROB_insert( p->pipe_ROB, id_inst );
+    id_inst.dr_tag = tag;
 
     // todo: Find space in REST and transfer this inst (valid=1, sched=0)
-    if ( REST_check_space( p->pipe_REST ) ) {
-      REST_insert( p->pipe_REST, id_inst );
-    }
+    REST_insert( p->pipe_REST, id_inst );
 
     // we place in the instruction in rest and change our rat
     if (id_inst.dest_reg != -1) {
@@ -385,6 +446,7 @@ extern int32_t NUM_REST_ENTRIES;
 
 typedef struct oldest {
   Inst_Info inst;
+  int slot;   // REST slot, no longer the same as dr_tag
   bool valid;
 } oldest_t;
 
@@ -399,9 +461,11 @@ oldest_t oldest(REST* t)
     if (o.valid == false && t->REST_Entries[i].valid && !t->REST_Entries[i].scheduled) {
       o.valid = true;
       o.inst = t->REST_Entries[i].inst;
+      o.slot = i;
     }
     else if (t->REST_Entries[i].valid && (t->REST_Entries[i].inst.inst_num < o.inst.inst_num) && !t->REST_Entries[i].scheduled) {
       o.inst = t->REST_Entries[i].inst;
+      o.slot = i;
     }
   }
   return o; 
@@ -423,6 +487,7 @@ oldest_t oldest_and_ready(REST* t)
 
       o.valid = true;
       o.inst = t->REST_Entries[i].inst;
+      o.slot = i;
     }
     else if (t->REST_Entries[i].valid && 
              (o.inst.inst_num > t->REST_Entries[i].inst.inst_num) && 
@@ -431,6 +496,7 @@ oldest_t oldest_and_ready(REST* t)
              t->REST_Entries[i].inst.src2_ready) {
 
       o.inst = t->REST_Entries[i].inst;
+      o.slot = i;
     }
   }
   return o;
@@ -449,13 +515,14 @@ void pipe_cycle_schedule(Pipeline *p){
     for(i=0; i<PIPE_WIDTH; i++){
       oldest_t o = oldest(p->pipe_REST);
       if (o.valid) {
-        int tag = o.inst.dr_tag;
-        if (p->pipe_REST->REST_Entries[tag].inst.src1_ready && p->pipe_REST->REST_Entries[tag].inst.src2_ready ) {
-          p->pipe_REST->REST_Entries[tag].scheduled = true;
+        int slot = o.slot;
+        if (p->pipe_REST->REST_Entries[slot].inst.src1_ready && p->pipe_REST->REST_Entries[slot].inst.src2_ready ) {
+          p->pipe_REST->REST_Entries[slot].scheduled = true;
           
           // stops at 18
           // printf("%d %d\n", o.inst.inst_num, o.valid);
-          p->SC_latch[i].inst = p->pipe_REST->REST_Entries[tag].inst;
+          p->SC_latch[i].inst = p->pipe_REST->REST_Entries[slot].inst;
+          p->SC_latch[i].inst.issue_cycle = p->stat_num_cycle;
           p->SC_latch[i].valid = true;
           p->SC_latch[i].stall = false;
         }
@@ -486,12 +553,13 @@ void pipe_cycle_schedule(Pipeline *p){
       oldest_t o = oldest_and_ready(p->pipe_REST);
 
       if (o.valid) {
-        int tag = o.inst.dr_tag;
+        int slot = o.slot;
 
-        if (p->pipe_REST->REST_Entries[tag].inst.src1_ready && p->pipe_REST->REST_Entries[tag].inst.src2_ready ) {
-          p->pipe_REST->REST_Entries[tag].scheduled = true;
+        if (p->pipe_REST->REST_Entries[slot].inst.src1_ready && p->pipe_REST->REST_Entries[slot].inst.src2_ready ) {
+          p->pipe_REST->REST_Entries[slot].scheduled = true;
 
-          p->SC_latch[i].inst = p->pipe_REST->REST_Entries[tag].inst;
+          p->SC_latch[i].inst = p->pipe_REST->REST_Entries[slot].inst;
+          p->SC_latch[i].inst.issue_cycle = p->stat_num_cycle;
           p->SC_latch[i].valid = true;
           p->SC_latch[i].stall = false;
         }
@@ -516,7 +584,9 @@ void pipe_cycle_broadcast(Pipeline *p){
     if (p->EX_latch[i].valid) {
       // printf("%d\n", p->EX_latch[i].inst.inst_num);
       Inst_Info ex_inst = p->EX_latch[i].inst;
+      ex_inst.complete_cycle = p->stat_num_cycle;
       REST_wakeup(p->pipe_REST, ex_inst.dr_tag);
+      REST_remove(p->pipe_REST, ex_inst);
       ROB_mark_ready(p->pipe_ROB, ex_inst);
 
       p->EX_latch[i].valid = false;
@@ -530,6 +600,35 @@ void pipe_cycle_broadcast(Pipeline *p){
 //--------------------------------------------------------------------//
 
 
+// Write one committed instruction to the event log
+void pipe_log_commit(Pipeline *p, Inst_Info *inst) {
+  EVLOG_Rec rec;
+  rec.inst_num = inst->inst_num;
+  rec.op_type  = inst->op_type;
+  rec.cycle[0] = inst->fetch_cycle;
+  rec.cycle[1] = inst->rename_cycle;
+  rec.cycle[2] = inst->issue_cycle;
+  rec.cycle[3] = inst->complete_cycle;
+  rec.cycle[4] = p->stat_num_cycle;
+  EVLOG_write(p->evlog, &rec);
+}
+
+// Attribute a commit slot that did not retire anything
+CPI_Stack pipe_commit_stall_cause(Pipeline *p) {
+  ROB_Entry *head = &p->pipe_ROB->ROB_Entries[p->pipe_ROB->head_ptr];
+
+  if ( !head->valid ) {
+    return CPI_ROB_EMPTY;
+  }
+  // rename runs after commit, so disp_blocked is last cycle's dispatch:
+  // the window is full and nothing younger can enter behind the head.
+  // The head decides the class, a load stays a load.
+  if ( head->inst.op_type == OP_LD ) {
+    return p->disp_blocked ? CPI_HEAD_LD_FULL : CPI_HEAD_LD;
+  }
+  return p->disp_blocked ? CPI_DISPATCH : CPI_HEAD_ALU;
+}
+
 void pipe_cycle_commit(Pipeline *p) {
   static uint32_t last = 1;
 
@@ -544,13 +643,19 @@ void pipe_cycle_commit(Pipeline *p) {
     if ( ROB_check_head(p->pipe_ROB) ) {
       p->stat_retired_inst++;
       Inst_Info commit_inst = ROB_remove_head(p->pipe_ROB);
-      REST_remove(p->pipe_REST, commit_inst);
       if (p->pipe_RAT->RAT_Entries[commit_inst.dest_reg].prf_id == commit_inst.dr_tag) {
         RAT_reset_entry( p->pipe_RAT, commit_inst.dest_reg );
       }
+      if(p->evlog && (commit_inst.inst_num != (uint64_t)-1)){
+        pipe_log_commit(p, &commit_inst); // skip the dummy terminate op
+      }
       if(commit_inst.inst_num >= p->halt_inst_num){
         p->halt=true;
       }
+      p->stat_cpi_slots[CPI_RETIRE]++;
+    }
+    else {
+      p->stat_cpi_slots[pipe_commit_stall_cause(p)]++;
     }
 
     if(SCHED_POLICY==0){
@@ -11,6 +11,7 @@
 #include "rest.h"
 #include "rob.h"
 #include "exeq.h"
+#include "evlog.h"
 
 #define MAX_PIPE_WIDTH 8
 #define MAX_BROADCASTS 256
@@ -19,6 +20,17 @@
 * Pipeline Class & Internal Structures
 **********************************************************************/
 
+// CPI stack: what each commit slot was spent on
+typedef enum CPI_Stack_Enum {
+  CPI_RETIRE,        // slot committed an instruction
+  CPI_ROB_EMPTY,     // nothing in ROB, front-end did not supply
+  CPI_HEAD_LD,       // ROB head is a load still executing
+  CPI_HEAD_ALU,      // ROB head is a non-load waiting on operands/exe
+  CPI_DISPATCH,      // ROB head a non-load, dispatch blocked on ROB/REST full
+  CPI_HEAD_LD_FULL,  // ROB head a load, dispatch blocked on ROB/REST full
+  NUM_CPI_TYPES
+} CPI_Stack;
+
 // Pipeline Latches 
 typedef struct Pipe_Latch_Struct {
   bool valid;
@@ -37,14 +49,25 @@ typedef struct Pipeline {
   RAT  *pipe_RAT;
   REST *pipe_REST;
   EXEQ *pipe_EXEQ;  // execution Q for multicycle ops (students need not implement this object)
+  EVLOG *evlog;     // optional event log, NULL when off
 
   uint64_t inst_num_tracker; //sequence number for inst
   uint64_t halt_inst_num;   // last inst in Trace
   bool halt;               // Pipeline is halted Flag
+  bool fetch_stop;         // stop fetching new insts (to drain for sampling)
+  uint64_t stat_skipped_inst; // insts fast-forwarded without timing
 
   // Statistics: students need to update these counters
   uint64_t stat_retired_inst;         // Total Commited Instructions
   uint64_t stat_num_cycle;            // Total Cycles
+
+  // Dispatch stall cycles, by the first cause that blocked rename
+  uint64_t stat_disp_stall_rob;       // ROB full
+  uint64_t stat_disp_stall_rest;      // REST full
+  uint64_t stat_disp_stall_rename;    // no decoded inst to rename
+  bool     disp_blocked;              // last rename hit ROB/REST full
+
+  uint64_t stat_cpi_slots[NUM_CPI_TYPES]; // commit slots, by cause
 }Pipeline;
 
 Pipeline* pipe_init(FILE *tr_file);        // Allocate Structures
@@ -57,7 +80,12 @@ void pipe_cycle_schedule(Pipeline *p);     // out of reservation station
 void pipe_cycle_exe(Pipeline *p);          // execute (multi-cycle?)
 void pipe_cycle_broadcast(Pipeline *p);    // broadcast and update ROB
 void pipe_cycle_commit(Pipeline *p);       // commit
+CPI_Stack pipe_commit_stall_cause(Pipeline *p); // why a commit slot idled
+void pipe_log_commit(Pipeline *p, Inst_Info *inst); // event log record
 
 void pipe_print_state(Pipeline *p);        // Print Pipeline state
 
+bool     pipe_is_drained(Pipeline *p);                // no inst in flight
+uint64_t pipe_skip_insts(Pipeline *p, uint64_t num);  // functional fast-forward
+
 #endif
@@ -5,10 +5,6 @@
 
 extern int32_t NUM_REST_ENTRIES;
 
-// do we really need separate vars for rat, rt, rob
-static int rest_count = 0;
-// static int rd = 0;
-// static int wr = 0;
 
 /////////////////////////////////////////////////////////////
 // Init function initializes the Reservation Station
@@ -21,6 +17,11 @@ REST* REST_init(void){
     t->REST_Entries[ii].valid=false;
   }
   assert(NUM_REST_ENTRIES<=MAX_REST_ENTRIES);
+
+  // only the first NUM_REST_ENTRIES slots are allocatable
+  for(ii=0; ii<NUM_REST_ENTRIES; ii++){
+    t->free_map[ii/64] |= (1ULL << (ii%64));
+  }
   return t;
 }
 
@@ -53,44 +54,60 @@ void REST_print_state(REST *t){
 /////////////////////////////////////////////////////////////
 
 bool  REST_check_space(REST *t){
+  return t->num_valid < NUM_REST_ENTRIES;
+}
 
-  // we are double doing this
-  // need to compile separately.
-  return rest_count < NUM_REST_ENTRIES;
+/////////////////////////////////////////////////////////////
+// Find the REST slot holding inst_num, -1 if not present
+/////////////////////////////////////////////////////////////
 
-/*
-  int i;
-  for(i=0; i<MAX_REST_ENTRIES; i++) {
-    if (t->REST_Entries[i].valid) {
-      return true;
+static int REST_find(REST *t, uint64_t inst_num){
+  int w;
+  for(w=0; w<REST_MAP_WORDS; w++) {
+    uint64_t used = ~t->free_map[w];
+    while(used) {
+      int i = w*64 + __builtin_ctzll(used);
+      used &= used-1;
+      if (i >= NUM_REST_ENTRIES) {
+        return -1;
+      }
+      if (t->REST_Entries[i].inst.inst_num == inst_num) {
+        return i;
+      }
     }
   }
-  return false;
-*/
-
+  return -1;
 }
 
 /////////////////////////////////////////////////////////////
 // Insert an inst in REST, must do check_space first
+// REST slots are allocated independently of the ROB tag,
+// returns the slot the instruction was placed in
 /////////////////////////////////////////////////////////////
 
-void  REST_insert(REST *t, Inst_Info inst){
+int  REST_insert(REST *t, Inst_Info inst){
 
   assert( REST_check_space(t) );
-
-  // putting in assertions to maintain invariants.
   assert( inst.dr_tag != -1);
-  assert( !t->REST_Entries[inst.dr_tag].scheduled );
-  
-  if (t->REST_Entries[inst.dr_tag].valid) {
-    // int i; for(i=0;i<NUM_REST_ENTRIES;i++){printf("tag: %d valid %d\n", i, t->REST_Entries[i].valid);}
-    fprintf(stderr, "tag: %d valid %d\n", inst.dr_tag, t->REST_Entries[inst.dr_tag].valid);
-    assert( !t->REST_Entries[inst.dr_tag].valid );
-  }
 
-  t->REST_Entries[inst.dr_tag].inst = inst;
-  t->REST_Entries[inst.dr_tag].valid = true;
-  rest_count++;
+  int w;
+  for(w=0; w<REST_MAP_WORDS; w++) {
+    if (t->free_map[w]) {
+      break;
+    }
+  }
+  assert( w < REST_MAP_WORDS );
+
+  int slot = w*64 + __builtin_ctzll(t->free_map[w]);
+  assert( slot < NUM_REST_ENTRIES );
+  assert( !t->REST_Entries[slot].valid );
+
+  t->free_map[w] &= ~(1ULL << (slot%64));
+  t->REST_Entries[slot].inst = inst;
+  t->REST_Entries[slot].valid = true;
+  t->REST_Entries[slot].scheduled = false;
+  t->num_valid++;
+  return slot;
 }
 
 /////////////////////////////////////////////////////////////
@@ -98,12 +115,13 @@ void  REST_insert(REST *t, Inst_Info inst){
 /////////////////////////////////////////////////////////////
 
 void  REST_remove(REST *t, Inst_Info inst){
-  // assert it is valid before removing
-  assert( inst.dr_tag != -1);
-  assert( t->REST_Entries[inst.dr_tag].valid );
-  t->REST_Entries[inst.dr_tag].valid = false;
-  t->REST_Entries[inst.dr_tag].scheduled = false;
-  rest_count--;
+  int slot = REST_find(t, inst.inst_num);
+  assert( slot != -1 );
+  assert( t->REST_Entries[slot].valid );
+  t->REST_Entries[slot].valid = false;
+  t->REST_Entries[slot].scheduled = false;
+  t->free_map[slot/64] |= (1ULL << (slot%64));
+  t->num_valid--;
 }
 
 /////////////////////////////////////////////////////////////
@@ -111,10 +129,15 @@ void  REST_remove(REST *t, Inst_Info inst){
 /////////////////////////////////////////////////////////////
 
 void REST_wakeup(REST *t, int tag){
-  int i;
-  // printf("broadcasting %d\n", tag);
-  for(i=0; i<MAX_REST_ENTRIES; i++) {
-    if(t->REST_Entries[i].valid) {
+  int w;
+  for(w=0; w<REST_MAP_WORDS; w++) {
+    uint64_t used = ~t->free_map[w];
+    while(used) {
+      int i = w*64 + __builtin_ctzll(used);
+      used &= used-1;
+      if (i >= NUM_REST_ENTRIES) {
+        return;
+      }
       if (t->REST_Entries[i].inst.src1_tag == tag) {
         t->REST_Entries[i].inst.src1_ready = true;
       }
@@ -130,24 +153,8 @@ void REST_wakeup(REST *t, int tag){
 /////////////////////////////////////////////////////////////
 
 void REST_schedule(REST *t, Inst_Info inst){
-  assert( inst.dr_tag != -1);
-  assert( t->REST_Entries[inst.dr_tag].valid );
-  assert( !t->REST_Entries[inst.dr_tag].scheduled );
-  t->REST_Entries[inst.dr_tag].scheduled = true;
+  int slot = REST_find(t, inst.inst_num);
+  assert( slot != -1 );
+  assert( !t->REST_Entries[slot].scheduled );
+  t->REST_Entries[slot].scheduled = true;
 }
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
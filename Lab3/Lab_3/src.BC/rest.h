@@ -6,6 +6,7 @@
 #include "trace.h"
 
 #define MAX_REST_ENTRIES 256
+#define REST_MAP_WORDS   (MAX_REST_ENTRIES/64)
 
 
 typedef struct REST_Entry_Struct {
@@ -19,6 +20,8 @@ typedef struct REST_Entry_Struct {
 
 typedef struct REST {
   REST_Entry  REST_Entries[MAX_REST_ENTRIES];
+  uint64_t    free_map[REST_MAP_WORDS]; // bit set => slot is free
+  int         num_valid;
 } REST;
 
 /////////////////////////////////////////////////////////////
@@ -28,7 +31,7 @@ REST* REST_init(void);
 void  REST_print_state(REST *t);
 
 bool  REST_check_space(REST *t);
-void  REST_insert(REST *t, Inst_Info inst);
+int   REST_insert(REST *t, Inst_Info inst);
 void  REST_remove(REST *t, Inst_Info inst);
 void  REST_wakeup(REST *t, int tag);
 void  REST_schedule(REST *t, Inst_Info inst);
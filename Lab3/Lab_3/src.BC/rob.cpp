@@ -15,6 +15,7 @@ static int rob_count;
 ROB* ROB_init(void){
   int ii;
   ROB *t = (ROB *) calloc (1, sizeof (ROB));
+  assert(NUM_ROB_ENTRIES<=MAX_ROB_ENTRIES);
   for(ii=0; ii<MAX_ROB_ENTRIES; ii++){
     t->ROB_Entries[ii].valid=false;
     t->ROB_Entries[ii].ready=false;
@@ -86,6 +87,7 @@ void ROB_mark_ready(ROB *t, Inst_Info inst){
   assert( inst.dr_tag != -1);
   assert( !t->ROB_Entries[inst.dr_tag].ready );
   t->ROB_Entries[inst.dr_tag].ready = true;
+  t->ROB_Entries[inst.dr_tag].inst = inst;
 }
 
 /////////////////////////////////////////////////////////////
@@ -9,9 +9,13 @@
 #include <stdlib.h>
 #include <assert.h>
 
+#include <math.h>
+
 #include "pipeline.h"
 
 #define HEARTBEAT_CYCLES 10000
+#define SAMPLE_Z95       1.96
+#define MAX_SIMPOINTS    64
 
 
 /*********************************************************************
@@ -30,12 +34,23 @@ void die_usage() {
     printf("   -pipewidth   <num>    Set width of pipeline to <num> (Default: 1)\n");
     printf("   -schedpolicy <num>    Scheduling policy [0:inorder 1:outoforder]  (Default: 1)\n");
     printf("   -loadlatency <num>    Number of cycles for LD to execute  (Default: 4)\n");
+    printf("   -robsize     <num>    Number of ROB entries (Default: 32)\n");
+    printf("   -restsize    <num>    Number of REST entries, independent of ROB (Default: 32)\n");
+    printf("   -evlog       <file>   Write a binary pipeline event log (view with evview)\n");
+    printf("   -sampleunit  <num>    Sampled mode: insts per measurement unit (Default: 0, off)\n");
+    printf("   -samplewarm  <num>    Sampled mode: detailed warm-up insts before each unit (Default: 2000)\n");
+    printf("   -sampleperiod <num>   Sampled mode: insts between unit starts (Default: 100000)\n");
+    printf("   -simpoints   <file>   Simulate only the weighted regions picked by bbvprof\n");
 }
 
 void check_heartbeat(void);
 
 void print_stats(void);
 
+void run_sampled(void);
+
+void run_simpoints(const char *fname);
+
 
 /*********************************************************************
  * Params and Globals
@@ -46,6 +61,29 @@ int32_t   NUM_ROB_ENTRIES=32;
 int32_t   LOAD_EXE_CYCLES=4;
 int32_t   SCHED_POLICY=1;
 
+uint64_t  SAMPLE_UNIT=0;      // 0: simulate every inst in detail
+uint64_t  SAMPLE_WARM=2000;
+uint64_t  SAMPLE_PERIOD=100000;
+
+// Sampled mode results, only the measurement units are counted
+uint64_t  sample_count;
+uint64_t  sample_inst;
+uint64_t  sample_cycle;
+uint64_t  sample_cpi_slots[NUM_CPI_TYPES];
+uint64_t  sample_disp_stall[3]; // ROB full, REST full, rename
+double    sample_cc;          // sums of cycles^2, insts^2, cycles*insts
+double    sample_ii;          // per unit, for the variance of CPI =
+double    sample_ci;          // sample_cycle/sample_inst (ratio estimator)
+
+// Simulation point mode results, one entry per simulated region
+uint32_t  simpoint_count;
+uint64_t  simpoint_total_inst;   // trace length seen by bbvprof
+double    simpoint_weight[MAX_SIMPOINTS];
+uint64_t  simpoint_inst[MAX_SIMPOINTS];
+uint64_t  simpoint_cycle[MAX_SIMPOINTS];
+uint64_t  simpoint_cpi_slots[MAX_SIMPOINTS][NUM_CPI_TYPES];
+uint64_t  simpoint_disp_stall[MAX_SIMPOINTS][3]; // ROB full, REST full, rename
+
 Pipeline *pipeline;
 /*********************************************************************
  * Main
@@ -57,6 +95,8 @@ int main(int argc, char *argv[])
 
     FILE *tr_file;
     char tr_filename[1024];
+    char evlog_filename[1024] = "";
+    char simpoint_filename[1024] = "";
     char cmd_string[256];
     
     if(argc < 1) {
@@ -94,6 +134,55 @@ int main(int argc, char *argv[])
 		}
 	    }
 
+	      else if (!strcmp(argv[ii], "-robsize")) {
+		if (ii < argc - 1) {		  
+		    NUM_ROB_ENTRIES = atoi(argv[ii+1]);
+		    ii += 1;
+		}
+	    }
+
+	      else if (!strcmp(argv[ii], "-restsize")) {
+		if (ii < argc - 1) {		  
+		    NUM_REST_ENTRIES = atoi(argv[ii+1]);
+		    ii += 1;
+		}
+	    }
+
+	      else if (!strcmp(argv[ii], "-sampleunit")) {
+		if (ii < argc - 1) {		  
+		    SAMPLE_UNIT = atoll(argv[ii+1]);
+		    ii += 1;
+		}
+	    }
+
+	      else if (!strcmp(argv[ii], "-samplewarm")) {
+		if (ii < argc - 1) {		  
+		    SAMPLE_WARM = atoll(argv[ii+1]);
+		    ii += 1;
+		}
+	    }
+
+	      else if (!strcmp(argv[ii], "-sampleperiod")) {
+		if (ii < argc - 1) {		  
+		    SAMPLE_PERIOD = atoll(argv[ii+1]);
+		    ii += 1;
+		}
+	    }
+
+	      else if (!strcmp(argv[ii], "-simpoints")) {
+		if (ii < argc - 1) {		  
+		    strcpy(simpoint_filename, argv[ii+1]);
+		    ii += 1;
+		}
+	    }
+
+	      else if (!strcmp(argv[ii], "-evlog")) {
+		if (ii < argc - 1) {		  
+		    strcpy(evlog_filename, argv[ii+1]);
+		    ii += 1;
+		}
+	    }
+
 
 	}
 	else {
@@ -115,19 +204,223 @@ int main(int argc, char *argv[])
 
      pipeline = pipe_init(tr_file); 
 
+     if(evlog_filename[0]) {
+       // Fetch, Rename, Issue, eXecute done (broadcast), Commit
+       if((pipeline->evlog = EVLOG_open_write(evlog_filename, "FRIXC")) == NULL) {
+         die_message("Unable to open the event log for writing");
+       }
+     }
+
      printf("\n%48s", "");
      
-    while(!pipeline->halt) {
-      pipe_cycle(pipeline);
-      check_heartbeat();
+    if(simpoint_filename[0]) {
+      SAMPLE_UNIT = 0;
+      run_simpoints(simpoint_filename);
+    }
+    else if(SAMPLE_UNIT) {
+      if(SAMPLE_WARM + SAMPLE_UNIT > SAMPLE_PERIOD) {
+        die_message("-sampleperiod must cover -samplewarm plus -sampleunit");
+      }
+      run_sampled();
+    }
+    else {
+      while(!pipeline->halt) {
+        pipe_cycle(pipeline);
+        check_heartbeat();
+      }
     }
 
   // ------- Print Statistics------------------------------------------
     print_stats();
+    if(pipeline->evlog) {
+      EVLOG_close(pipeline->evlog);
+    }
     fclose(tr_file);
     return 0;
 }
 
+/*********************************************************************
+ * Sampled Simulation (SMARTS style)
+ *
+ * Every SAMPLE_PERIOD insts: SAMPLE_WARM insts of detailed warm-up,
+ * SAMPLE_UNIT insts of detailed measurement, then drain the pipeline
+ * and fast-forward the trace to the start of the next period. There is
+ * no predictor or cache state in Lab3 to warm while fast-forwarding.
+ *********************************************************************/
+
+void run_until_retired(uint64_t target) {
+    while(!pipeline->halt && pipeline->stat_retired_inst < target) {
+      pipe_cycle(pipeline);
+      check_heartbeat();
+    }
+}
+
+// Stop fetching and let everything in flight commit
+void drain_pipeline(void) {
+    pipeline->fetch_stop = true;
+    while(!pipeline->halt && !pipe_is_drained(pipeline)) {
+      pipe_cycle(pipeline);
+      check_heartbeat();
+    }
+}
+
+// Fast-forward a drained pipeline to trace position pos, then resume fetch
+void skip_to(uint64_t pos) {
+    uint64_t trace_pos = pipeline->inst_num_tracker + pipeline->stat_skipped_inst;
+    if(pos > trace_pos) {
+      pipe_skip_insts(pipeline, pos - trace_pos);
+    }
+    pipeline->fetch_stop = false;
+}
+
+void run_sampled(void) {
+    uint64_t period_start = 0; // trace position of this period
+
+    while(!pipeline->halt) {
+      run_until_retired(pipeline->stat_retired_inst + SAMPLE_WARM);
+
+      uint64_t inst0  = pipeline->stat_retired_inst;
+      uint64_t cycle0 = pipeline->stat_num_cycle;
+      uint64_t slots0[NUM_CPI_TYPES];
+      memcpy(slots0, pipeline->stat_cpi_slots, sizeof(slots0));
+      uint64_t stall0[3] = {pipeline->stat_disp_stall_rob,
+                            pipeline->stat_disp_stall_rest,
+                            pipeline->stat_disp_stall_rename};
+
+      run_until_retired(inst0 + SAMPLE_UNIT);
+
+      uint64_t unit_inst  = pipeline->stat_retired_inst - inst0;
+      uint64_t unit_cycle = pipeline->stat_num_cycle - cycle0;
+      if(unit_inst >= SAMPLE_UNIT/2) { // drop a tiny unit at end of trace
+        sample_count++;
+        sample_cc += (double)unit_cycle*(double)unit_cycle;
+        sample_ii += (double)unit_inst*(double)unit_inst;
+        sample_ci += (double)unit_cycle*(double)unit_inst;
+
+        sample_inst  += unit_inst;
+        sample_cycle += unit_cycle;
+        for(int ii = 0; ii < NUM_CPI_TYPES; ii++) {
+          sample_cpi_slots[ii] += pipeline->stat_cpi_slots[ii] - slots0[ii];
+        }
+        sample_disp_stall[0] += pipeline->stat_disp_stall_rob - stall0[0];
+        sample_disp_stall[1] += pipeline->stat_disp_stall_rest - stall0[1];
+        sample_disp_stall[2] += pipeline->stat_disp_stall_rename - stall0[2];
+      }
+
+      // drain, then skip to the start of the next period
+      drain_pipeline();
+      if(pipeline->halt) {
+        break;
+      }
+      period_start += SAMPLE_PERIOD;
+      skip_to(period_start);
+    }
+
+    if(sample_count == 0) {
+      die_message("No sampling unit could be measured");
+    }
+}
+
+/*********************************************************************
+ * Simulation Points (SimPoint style)
+ *
+ * The points file from bbvprof lists "interval <insts>", "intervals
+ * <count>" and then one "<interval index> <weight>" line per region, in
+ * trace order. Each region gets SAMPLE_WARM insts of detailed warm-up
+ * and is then measured for one interval; the whole-trace CPI is the
+ * weighted sum of the region CPIs.
+ *********************************************************************/
+
+void run_simpoints(const char *fname) {
+    FILE *fp = fopen(fname, "r");
+    char line[256];
+    uint64_t interval = 0;
+    uint64_t idx[MAX_SIMPOINTS];
+    double   weight[MAX_SIMPOINTS];
+    uint32_t num_points = 0;
+
+    if(fp == NULL) {
+      die_message("Unable to open the simpoints file");
+    }
+    while(fgets(line, sizeof(line), fp)) {
+      unsigned long long a;
+      double w;
+      if(line[0] == '#') {
+        continue;
+      }
+      if(sscanf(line, "interval %llu", &a) == 1) {
+        interval = a;
+      }
+      else if(sscanf(line, "intervals %llu", &a) == 1) {
+        simpoint_total_inst = a;
+      }
+      else if(sscanf(line, "%llu %lf", &a, &w) == 2) {
+        if(num_points == MAX_SIMPOINTS) {
+          die_message("Too many simulation points");
+        }
+        if(num_points && a <= idx[num_points-1]) {
+          die_message("Simulation points must be in trace order");
+        }
+        idx[num_points] = a;
+        weight[num_points] = w;
+        num_points++;
+      }
+    }
+    fclose(fp);
+    if(interval == 0 || num_points == 0) {
+      die_message("No simulation points in the simpoints file");
+    }
+    simpoint_total_inst *= interval;
+
+    for(uint32_t pp = 0; pp < num_points && !pipeline->halt; pp++) {
+      uint64_t start = idx[pp]*interval;
+      uint64_t warm_start = (start > SAMPLE_WARM) ? start - SAMPLE_WARM : 0;
+      uint64_t trace_pos = pipeline->inst_num_tracker + pipeline->stat_skipped_inst;
+
+      // regions close to the last one just keep running in detail
+      if(warm_start > trace_pos) {
+        drain_pipeline();
+        if(pipeline->halt) {
+          break;
+        }
+        skip_to(warm_start);
+      }
+      uint64_t commit_pos = pipeline->stat_retired_inst + pipeline->stat_skipped_inst;
+      if(start > commit_pos) {
+        run_until_retired(pipeline->stat_retired_inst + (start - commit_pos));
+      }
+
+      uint64_t inst0  = pipeline->stat_retired_inst;
+      uint64_t cycle0 = pipeline->stat_num_cycle;
+      uint64_t slots0[NUM_CPI_TYPES];
+      memcpy(slots0, pipeline->stat_cpi_slots, sizeof(slots0));
+      uint64_t stall0[3] = {pipeline->stat_disp_stall_rob,
+                            pipeline->stat_disp_stall_rest,
+                            pipeline->stat_disp_stall_rename};
+
+      run_until_retired(inst0 + interval);
+
+      uint64_t unit_inst = pipeline->stat_retired_inst - inst0;
+      if(unit_inst < interval/2) { // trace ended inside the region
+        continue;
+      }
+      uint32_t nn = simpoint_count++;
+      simpoint_weight[nn] = weight[pp];
+      simpoint_inst[nn]   = unit_inst;
+      simpoint_cycle[nn]  = pipeline->stat_num_cycle - cycle0;
+      for(int ii = 0; ii < NUM_CPI_TYPES; ii++) {
+        simpoint_cpi_slots[nn][ii] = pipeline->stat_cpi_slots[ii] - slots0[ii];
+      }
+      simpoint_disp_stall[nn][0] = pipeline->stat_disp_stall_rob - stall0[0];
+      simpoint_disp_stall[nn][1] = pipeline->stat_disp_stall_rest - stall0[1];
+      simpoint_disp_stall[nn][2] = pipeline->stat_disp_stall_rename - stall0[2];
+    }
+
+    if(simpoint_count == 0) {
+      die_message("No simulation point could be simulated");
+    }
+}
+
 /*********************************************************************
  * Print Statistics 
  *********************************************************************/
@@ -138,6 +431,54 @@ void print_stats(void) {
     uint64_t stat_num_inst       = pipeline->stat_retired_inst;
     uint64_t stat_num_cycle      = pipeline->stat_num_cycle;
     double cpi = (double)(stat_num_cycle)/(double)(stat_num_inst);
+    uint64_t *cpi_slots          = pipeline->stat_cpi_slots;
+    double    cpi_stack[NUM_CPI_TYPES];
+    uint64_t  disp_stall[3]      = {pipeline->stat_disp_stall_rob,
+                                    pipeline->stat_disp_stall_rest,
+                                    pipeline->stat_disp_stall_rename};
+
+    if(SAMPLE_UNIT) {
+      // report the whole trace, with CPI estimated from the units
+      cpi            = (double)sample_cycle/(double)sample_inst;
+      cpi_slots      = sample_cpi_slots;
+      memcpy(disp_stall, sample_disp_stall, sizeof(disp_stall)); // units only
+      stat_num_inst  = pipeline->stat_retired_inst + pipeline->stat_skipped_inst;
+      stat_num_cycle = (uint64_t)(cpi*(double)stat_num_inst);
+    }
+
+    double slot_scale = (double)PIPE_WIDTH * (double)(SAMPLE_UNIT ? sample_inst : stat_num_inst);
+    for(int ii = 0; ii < NUM_CPI_TYPES; ii++) {
+      cpi_stack[ii] = (double)cpi_slots[ii]/slot_scale;
+    }
+
+    if(simpoint_count) {
+      // weights are renormalized over the regions actually simulated;
+      // stall counts are weighted per inst and scaled to the trace
+      double wsum = 0, stall_rate[3] = {0, 0, 0};
+      cpi = 0;
+      memset(cpi_stack, 0, sizeof(cpi_stack));
+      for(uint32_t pp = 0; pp < simpoint_count; pp++) {
+        double w = simpoint_weight[pp];
+        wsum += w;
+        cpi  += w*(double)simpoint_cycle[pp]/(double)simpoint_inst[pp];
+        for(int ii = 0; ii < NUM_CPI_TYPES; ii++) {
+          cpi_stack[ii] += w*(double)simpoint_cpi_slots[pp][ii] /
+                           ((double)PIPE_WIDTH*(double)simpoint_inst[pp]);
+        }
+        for(int ii = 0; ii < 3; ii++) {
+          stall_rate[ii] += w*(double)simpoint_disp_stall[pp][ii]/(double)simpoint_inst[pp];
+        }
+      }
+      cpi /= wsum;
+      for(int ii = 0; ii < NUM_CPI_TYPES; ii++) {
+        cpi_stack[ii] /= wsum;
+      }
+      stat_num_inst  = simpoint_total_inst;
+      stat_num_cycle = (uint64_t)(cpi*(double)stat_num_inst);
+      for(int ii = 0; ii < 3; ii++) {
+        disp_stall[ii] = (uint64_t)(stall_rate[ii]/wsum*(double)stat_num_inst);
+      }
+    }
 
     printf("\n\n");
   
@@ -145,6 +486,48 @@ void print_stats(void) {
     printf("\n%s_NUM_CYCLES         \t : %10u" , header, (uint32_t)stat_num_cycle);
     printf("\n%s_CPI                \t : %10.3f" , header, cpi);
 
+    printf("\n%s_ROB_ENTRIES        \t : %10u" , header, (uint32_t)NUM_ROB_ENTRIES);
+    printf("\n%s_REST_ENTRIES       \t : %10u" , header, (uint32_t)NUM_REST_ENTRIES);
+    printf("\n%s_STALL_ROB_FULL     \t : %10u" , header, (uint32_t)disp_stall[0]);
+    printf("\n%s_STALL_REST_FULL    \t : %10u" , header, (uint32_t)disp_stall[1]);
+    printf("\n%s_STALL_RENAME       \t : %10u" , header, (uint32_t)disp_stall[2]);
+
+    // CPI stack, each component is commit slots / (width * insts)
+    const char *cpi_names[NUM_CPI_TYPES] = {"RETIRE", "ROB_EMPTY", "HEAD_LD", "HEAD_ALU", "DISPATCH", "HEAD_LD_FULL"};
+    for(int ii = 0; ii < NUM_CPI_TYPES; ii++) {
+      printf("\n%s_CPI_%-15s\t : %10.3f" , header, cpi_names[ii], cpi_stack[ii]);
+    }
+
+    if(SAMPLE_UNIT) {
+      double stddev = 0, ci95 = 0, needed = 0;
+      if(sample_count > 1) {
+        // CPI is a ratio of sums: its per-unit spread is that of the
+        // residuals cycles - cpi*insts, in units of the mean unit length
+        double n      = (double)sample_count;
+        double mean_i = (double)sample_inst/n;
+        double ss     = sample_cc - 2*cpi*sample_ci + cpi*cpi*sample_ii;
+        stddev = sqrt((ss > 0 ? ss : 0)/(n-1))/mean_i;
+        ci95   = SAMPLE_Z95*stddev/sqrt(n);
+        // units needed for +-2% at 95% confidence
+        needed = pow(SAMPLE_Z95*(stddev/cpi)/0.02, 2);
+      }
+      printf("\n%s_SAMPLE_UNITS       \t : %10u" , header, (uint32_t)sample_count);
+      printf("\n%s_SAMPLE_DETAIL_INST \t : %10u" , header, (uint32_t)pipeline->stat_retired_inst);
+      printf("\n%s_SAMPLE_CPI_STDDEV  \t : %10.3f" , header, stddev);
+      printf("\n%s_SAMPLE_CPI_CI95    \t : %10.3f" , header, ci95);
+      printf("\n%s_SAMPLE_CPI_CI95_PCT\t : %10.3f" , header, 100.0*ci95/cpi);
+      printf("\n%s_SAMPLE_UNITS_FOR_2PCT\t : %10.0f" , header, ceil(needed));
+    }
+
+    if(simpoint_count) {
+      printf("\n%s_SIMPOINT_REGIONS   \t : %10u" , header, simpoint_count);
+      printf("\n%s_SIMPOINT_DETAIL_INST\t : %10u" , header, (uint32_t)pipeline->stat_retired_inst);
+      for(uint32_t pp = 0; pp < simpoint_count; pp++) {
+        printf("\n%s_SIMPOINT_%-10u\t : %10.3f (weight %.4f)" , header, pp,
+               (double)simpoint_cycle[pp]/(double)simpoint_inst[pp], simpoint_weight[pp]);
+      }
+    }
+
     printf("\n\n");
 }
 
@@ -52,6 +52,12 @@ typedef struct Inst_Info_Struct {
 
   // needed for multi-cycle execution
   int      exe_wait_cycles; // we will use this
+
+  // cycle the inst entered each stage (for the event log)
+  uint64_t fetch_cycle;
+  uint64_t rename_cycle;
+  uint64_t issue_cycle;
+  uint64_t complete_cycle;
   
 } Inst_Info;
 
@@ -1,12 +1,25 @@
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <math.h>
 
 #include "cache.h"
 
 
 extern uns64 SWP_CORE0_WAYS; // Input Way partitions for Core 0       
-extern uns64 cycle; // You can use this as timestamp for LRU
+extern uns64 SWP_WAYS[MAX_CORES]; // Per-core quotas, if SWP_NUM_QUOTAS
+extern uns64 SWP_NUM_QUOTAS;
+extern uns64 NUM_CORES;
+extern __thread uns64 cycle; // You can use this as timestamp for LRU
+
+static void swp_new(Cache *c);
+static void ucp_new(Cache *c);
+static void ucp_monitor(Cache *c, uns set_index, Addr tag, uns core_id);
+static uns  ucp_victim(Cache *c, uns set_index, uns core_id);
+static Flag cache_sample_access(Cache *c, uns is_write, uns core_id);
+static void cache_sample_install(Cache *c, Addr lineaddr, uns set_index, uns core_id);
+static Flag cache_dueling_leader(Cache *c, uns set_index);
 
 ////////////////////////////////////////////////////////////////////
 // ------------- DO NOT MODIFY THE INIT FUNCTION -----------
@@ -26,6 +39,53 @@ Cache  *cache_new(uns64 size, uns64 assoc, uns64 linesize, uns64 repl_policy){
    // determine num sets, and init the cache
    c->num_sets = size/(linesize*assoc);
    c->sets  = (Cache_Set *) calloc (c->num_sets, sizeof(Cache_Set));
+   c->way_mask = (uns)((1ULL << c->num_ways) - 1);
+   c->rrpv_lo  = (uns)(0x5555555555555555ULL & ((1ULL << (2*c->num_ways)) - 1));
+   while((1u << c->plru_levels) < c->num_ways){
+     c->plru_levels++;
+   }
+   c->drrip_stride = c->num_sets/DRRIP_LEADERS;
+   if(c->drrip_stride < 4){
+     c->drrip_stride = 4;
+   }
+   if((c->repl_policy == REPL_TADIP || c->repl_policy == REPL_TADRRIP) &&
+      c->drrip_stride < 2*NUM_CORES){ // two leaders per core
+     c->drrip_stride = 2*NUM_CORES;
+   }
+   c->drrip_psel = (DRRIP_PSEL_MAX+1)/2;
+   if(c->repl_policy == REPL_SWP){
+     swp_new(c);
+   }
+   if(c->repl_policy == REPL_UCP){
+     ucp_new(c);
+   }
+
+   uns64 ii, jj;
+   for(ii=0; ii<MAX_CORES; ii++){
+     c->ta_psel[ii] = (DRRIP_PSEL_MAX+1)/2;
+   }
+   for(ii=0; ii<c->num_sets; ii++){
+     for(jj=0; jj<MAX_WAYS; jj++){
+       c->sets[ii].key[jj] = CACHE_KEY_INVALID;
+     }
+     // way 0 starts as the LRU way, unused nibbles stay at 15
+     c->sets[ii].ages = ~0ULL;
+     for(jj=0; jj<c->num_ways; jj++){
+       c->sets[ii].ages &= ~((uns64)(15 - (c->num_ways-1-jj)) << (4*jj));
+     }
+     c->sets[ii].rrpv = RRIP_MAX * c->rrpv_lo;
+   }
+
+   // pick the index path once, lookups never divide
+   if((c->num_sets & (c->num_sets-1)) == 0){
+     c->index_mode = CACHE_INDEX_POW2;
+     c->set_shift  = __builtin_ctzll(c->num_sets);
+     c->set_mask   = c->num_sets-1;
+   }
+   else{
+     c->index_mode = CACHE_INDEX_RECIP;
+     c->set_recip  = ~0ULL / c->num_sets;
+   }
 
    return c;
 }
@@ -54,11 +114,528 @@ void    cache_print_stats    (Cache *c, char *header){
   printf("\n%s_WRITE_MISSPERC \t\t : %10.3f", header, 100*write_mr);
   printf("\n%s_DIRTY_EVICTS   \t\t : %10llu", header, c->stat_dirty_evicts);
 
+  if(c->ucp){
+    uns ii;
+    printf("\n%s_UCP_REPARTITIONS\t\t : %10llu", header, c->ucp->stat_repartitions);
+    for(ii=0; ii<NUM_CORES; ii++){
+      printf("\n%s_UCP_WAYS_CORE%u \t\t : %10u", header, ii, c->ucp->alloc[ii]);
+    }
+  }
+
+  if(c->mshr){
+    uns64 alloc = c->stat_mshr_alloc;
+    printf("\n%s_MSHR_ALLOC     \t\t : %10llu", header, alloc);
+    printf("\n%s_MSHR_MERGE     \t\t : %10llu", header, c->stat_mshr_merge);
+    printf("\n%s_MSHR_FULL      \t\t : %10llu", header, c->stat_mshr_full);
+    printf("\n%s_MSHR_FULL_WAIT \t\t : %10llu", header, c->stat_mshr_full_wait);
+    printf("\n%s_MSHR_AVG_BUSY  \t\t : %10.3f", header,
+           alloc ? (double)c->stat_mshr_occupancy/(double)alloc : 0.0);
+  }
+
+  if(c->sample){
+    Cache_Sample *s = c->sample;
+    uns64 all_reads;
+    double err, est_mr = cache_sample_estimate(c, FALSE, &all_reads, &err);
+    printf("\n%s_SAMPLE_SETS    \t\t : %10u", header, s->num_sampled);
+    printf("\n%s_SAMPLE_LEADER_SETS\t : %10u", header, s->num_leaders);
+    printf("\n%s_EST_READ_ACCESS\t\t : %10llu", header, all_reads);
+    printf("\n%s_EST_READ_MISS  \t\t : %10llu", header, (uns64)(est_mr*all_reads + 0.5));
+    printf("\n%s_EST_READ_MISSPERC\t\t : %10.3f", header, 100*est_mr);
+    printf("\n%s_EST_READ_MISSPERC_ERR\t : %10.3f", header, 100*err);
+    printf("\n%s_EST_DIRTY_EVICTS\t\t : %10llu", header, cache_sample_dirty_evicts(c));
+    printf("\n%s_CHARGED_READ_MISS\t\t : %10llu", header, c->stat_read_miss + s->stat_read_miss);
+    printf("\n%s_CHARGED_DIRTY_EVICTS\t : %10llu", header, c->stat_dirty_evicts + s->stat_dirty_evicts);
+  }
+
+  if(c->wbb){
+    printf("\n%s_WBB_WRITEBACKS \t\t : %10llu", header, c->stat_wbb_writebacks);
+    printf("\n%s_WBB_COALESCED  \t\t : %10llu", header, c->stat_wbb_coalesced);
+    printf("\n%s_WBB_FULL       \t\t : %10llu", header, c->stat_wbb_full);
+    printf("\n%s_WBB_FULL_WAIT  \t\t : %10llu", header, c->stat_wbb_full_wait);
+  }
+
   printf("\n");
 }
 
 
 
+////////////////////////////////////////////////////////////////////
+// MSHRs. The tag array is updated at miss time, so a later access to
+// a line whose fill is still in flight hits in the cache; it is a
+// secondary miss and has to wait for the pending fill.
+////////////////////////////////////////////////////////////////////
+
+void    cache_mshr_init(Cache *c, uns num_mshrs){
+  c->num_mshrs = num_mshrs;
+  c->mshr = num_mshrs ? (Cache_MSHR *) calloc (num_mshrs, sizeof(Cache_MSHR)) : NULL;
+}
+
+// Delay of a hit on lineaddr, stretched if its fill has not arrived
+uns64   cache_mshr_merge(Cache *c, Addr lineaddr, uns64 delay){
+  uns ii;
+  for(ii=0; ii<c->num_mshrs; ii++){
+    if(c->mshr[ii].lineaddr == lineaddr && c->mshr[ii].ready_cycle > cycle + delay){
+      c->stat_mshr_merge++;
+      return c->mshr[ii].ready_cycle - cycle;
+    }
+  }
+  return delay;
+}
+
+// Cycles a primary miss issued now waits for a free entry
+uns64   cache_mshr_alloc(Cache *c){
+  uns64 first_free = ~0ULL;
+  uns ii;
+
+  c->stat_mshr_alloc++;
+  for(ii=0; ii<c->num_mshrs; ii++){
+    if(c->mshr[ii].ready_cycle > cycle){
+      c->stat_mshr_occupancy++;
+    }
+    if(c->mshr[ii].ready_cycle < first_free){
+      first_free = c->mshr[ii].ready_cycle;
+    }
+  }
+
+  if(first_free <= cycle){
+    return 0;
+  }
+  c->stat_mshr_full++;
+  c->stat_mshr_full_wait += first_free - cycle;
+  return first_free - cycle;
+}
+
+// Track the fill of lineaddr in the entry that frees up first
+void    cache_mshr_fill(Cache *c, Addr lineaddr, uns64 ready_cycle){
+  uns ii, pick = 0;
+  for(ii=1; ii<c->num_mshrs; ii++){
+    if(c->mshr[ii].ready_cycle < c->mshr[pick].ready_cycle){
+      pick = ii;
+    }
+  }
+  c->mshr[pick].lineaddr    = lineaddr;
+  c->mshr[pick].ready_cycle = ready_cycle;
+}
+
+////////////////////////////////////////////////////////////////////
+// Write-back buffer. A dirty victim leaves the cache when the fill
+// that evicts it arrives (cycle when) and waits here while memsys
+// writes it to the next level; that fill only waits when every entry
+// is still draining.
+////////////////////////////////////////////////////////////////////
+
+void    cache_wbb_init(Cache *c, uns num_wbb){
+  c->num_wbb = num_wbb;
+  c->wbb = num_wbb ? (Cache_WBB_Entry *) calloc (num_wbb, sizeof(Cache_WBB_Entry)) : NULL;
+}
+
+// TRUE if lineaddr is still queued at cycle when, the victim merges
+Flag    cache_wbb_coalesce(Cache *c, Addr lineaddr, uns64 when){
+  uns ii;
+  for(ii=0; ii<c->num_wbb; ii++){
+    if(c->wbb[ii].lineaddr == lineaddr && c->wbb[ii].done_cycle > when){
+      c->stat_wbb_coalesced++;
+      return TRUE;
+    }
+  }
+  return FALSE;
+}
+
+// Cycles a victim leaving at cycle when waits for a free entry
+uns64   cache_wbb_alloc(Cache *c, uns64 when){
+  uns64 first_free = ~0ULL;
+  uns ii;
+
+  c->stat_wbb_writebacks++;
+  for(ii=0; ii<c->num_wbb; ii++){
+    if(c->wbb[ii].done_cycle < first_free){
+      first_free = c->wbb[ii].done_cycle;
+    }
+  }
+
+  if(first_free <= when){
+    return 0;
+  }
+  c->stat_wbb_full++;
+  c->stat_wbb_full_wait += first_free - when;
+  return first_free - when;
+}
+
+// Track the writeback of lineaddr in the entry that frees up first
+void    cache_wbb_fill(Cache *c, Addr lineaddr, uns64 done_cycle){
+  uns ii, pick = 0;
+  for(ii=1; ii<c->num_wbb; ii++){
+    if(c->wbb[ii].done_cycle < c->wbb[pick].done_cycle){
+      pick = ii;
+    }
+  }
+  c->wbb[pick].lineaddr   = lineaddr;
+  c->wbb[pick].done_cycle = done_cycle;
+}
+
+////////////////////////////////////////////////////////////////////
+// Set sampling. The RANDOM sets are picked by a hash of the set index
+// so that they do not line up with strided access patterns; there are
+// about num_sets/sample of them. Set-dueling leaders are always modeled.
+////////////////////////////////////////////////////////////////////
+
+static Flag cache_dueling_leader(Cache *c, uns set_index){
+  uns leader = set_index % c->drrip_stride;
+
+  if(c->repl_policy == REPL_DRRIP){
+    return leader == 0 || leader == c->drrip_stride/2;
+  }
+  if(c->repl_policy == REPL_TADIP || c->repl_policy == REPL_TADRRIP){
+    return leader < 2*NUM_CORES;
+  }
+  return FALSE;
+}
+
+void    cache_sample_init(Cache *c, uns sample){
+  Cache_Sample *s = (Cache_Sample *) calloc (1, sizeof (Cache_Sample));
+  uns64 ii;
+
+  s->map          = (uns8 *) calloc (c->num_sets, sizeof(uns8));
+  s->read_access  = (uns64 *) calloc (c->num_sets, sizeof(uns64));
+  s->read_miss    = (uns64 *) calloc (c->num_sets, sizeof(uns64));
+  s->write_access = (uns64 *) calloc (c->num_sets, sizeof(uns64));
+  s->write_miss   = (uns64 *) calloc (c->num_sets, sizeof(uns64));
+  for(ii=0; ii<c->num_sets; ii++){
+    if(cache_dueling_leader(c, ii)){
+      s->map[ii] = CACHE_SAMPLE_LEADER;
+      s->num_leaders++;
+    }
+    else if(((uns)((ii * 0x9E3779B97F4A7C15ULL) >> 40) % sample) == 0){
+      s->map[ii] = CACHE_SAMPLE_RANDOM;
+      s->num_sampled++;
+    }
+  }
+  // small caches: the interval needs at least two sets
+  for(ii=0; ii<c->num_sets && s->num_sampled < 2; ii++){
+    if(s->map[ii] == CACHE_SAMPLE_SKIP){
+      s->map[ii] = CACHE_SAMPLE_RANDOM;
+      s->num_sampled++;
+    }
+  }
+  for(ii=0; ii<MAX_CORES; ii++){
+    s->ratio_read[ii]  = 1.0;   // cold
+    s->ratio_write[ii] = 1.0;
+  }
+  c->sample = s;
+}
+
+// A moving average rather than the ratio so far, which would keep
+// charging the cold misses of the start long after warmup
+static inline void cache_sample_observe(double *ratio, Flag event){
+  *ratio += ((event ? 1.0 : 0.0) - *ratio) / CACHE_SAMPLE_EMA;
+}
+
+// Adds ratio to credit and charges one event per whole unit
+static Flag cache_sample_charge(double *credit, double ratio){
+  *credit += ratio;
+  if(*credit >= 1.0){
+    *credit -= 1.0;
+    return TRUE;
+  }
+  return FALSE;
+}
+
+// An access to a set that is not modeled
+static Flag cache_sample_access(Cache *c, uns is_write, uns core_id){
+  Cache_Sample *s = c->sample;
+
+  c->last_hit_prefetched = FALSE;
+  if(is_write){
+    s->stat_write_access++;
+    if(cache_sample_charge(&s->credit_write[core_id], s->ratio_write[core_id])){
+      s->stat_write_miss++;
+      return MISS;
+    }
+  }
+  else{
+    s->stat_read_access++;
+    if(cache_sample_charge(&s->credit_read[core_id], s->ratio_read[core_id])){
+      s->stat_read_miss++;
+      return MISS;
+    }
+  }
+  return HIT;
+}
+
+// An install in a set that is not modeled. A charged dirty victim is
+// the next line up that maps to the same set.
+static void cache_sample_install(Cache *c, Addr lineaddr, uns set_index, uns core_id){
+  Cache_Sample *s = c->sample;
+  Cache_Line *evict = &c->last_evicted_line;
+
+  memset(evict, 0, sizeof(Cache_Line));
+  if(cache_sample_charge(&s->credit_dirty, s->ratio_dirty)){
+    evict->valid   = TRUE;
+    evict->dirty   = TRUE;
+    evict->core_id = core_id;
+    c->last_evicted_lineaddr = lineaddr + c->num_sets;
+    s->stat_dirty_evicts++;
+  }
+  c->last_install_set = set_index;
+  c->last_install_way = 0;
+}
+
+// Miss ratio over every set, demand reads only or reads and writes:
+// the LEADER sets as counted, the rest at the ratio of the RANDOM sets.
+// *access gets the demand accesses of every set and *err the half width
+// of the 95% confidence interval, where each RANDOM set is one cluster
+// of accesses (ratio estimator, with the finite population correction
+// for sampling sets without replacement). The interval covers the
+// choice of sets only, not the approximate timing.
+double  cache_sample_estimate(Cache *c, Flag with_writes, uns64 *access, double *err){
+  Cache_Sample *s = c->sample;
+  double lead_access = 0, lead_miss = 0, rand_access = 0, rand_miss = 0, sum = 0;
+  uns64 ii;
+
+  *access = c->stat_read_access + s->stat_read_access;
+  if(with_writes){
+    *access += c->stat_write_access + s->stat_write_access;
+  }
+  *err = 0;
+
+  for(ii=0; ii<c->num_sets; ii++){
+    double a = s->read_access[ii] + (with_writes ? s->write_access[ii] : 0);
+    double m = s->read_miss[ii]   + (with_writes ? s->write_miss[ii]   : 0);
+    if(s->map[ii] == CACHE_SAMPLE_LEADER){
+      lead_access += a;
+      lead_miss   += m;
+    }
+    else if(s->map[ii] == CACHE_SAMPLE_RANDOM){
+      rand_access += a;
+      rand_miss   += m;
+    }
+  }
+  if(!*access){
+    return 0;
+  }
+
+  double rest    = (double)*access - lead_access;
+  double rand_mr = rand_access ? rand_miss/rand_access : 0;
+  if(s->num_sampled >= 2 && rand_access){
+    double n = s->num_sampled;
+    for(ii=0; ii<c->num_sets; ii++){
+      if(s->map[ii] == CACHE_SAMPLE_RANDOM){
+        double a = s->read_access[ii] + (with_writes ? s->write_access[ii] : 0);
+        double m = s->read_miss[ii]   + (with_writes ? s->write_miss[ii]   : 0);
+        sum += (m - rand_mr*a)*(m - rand_mr*a);
+      }
+    }
+    double mean_access = rand_access/n;
+    double var = (1.0 - n/(double)(c->num_sets - s->num_leaders)) * sum/(n-1) / (n*mean_access*mean_access);
+    *err = 1.96*sqrt(var) * rest/(double)*access;
+  }
+  return (lead_miss + rand_mr*rest)/(double)*access;
+}
+
+// Tag-only callers (-sweep) with nothing downstream to charge: counts
+// an access to a set that is not modeled and returns TRUE, FALSE if the
+// set is modeled and the access should go to cache_access
+Flag    cache_sample_skip(Cache *c, Addr lineaddr, uns is_write){
+  Addr tag;
+  uns  index = cache_index_tag(c, lineaddr, &tag);
+
+  if(c->sample->map[index]){
+    return FALSE;
+  }
+  if(is_write){
+    c->sample->stat_write_access++;
+  }
+  else{
+    c->sample->stat_read_access++;
+  }
+  return TRUE;
+}
+
+// Dirty evictions of every set, scaled the same way
+uns64   cache_sample_dirty_evicts(Cache *c){
+  Cache_Sample *s = c->sample;
+  uns64 est = s->stat_leader_dirty_evicts;
+
+  if(s->num_sampled){
+    est += (c->stat_dirty_evicts - s->stat_leader_dirty_evicts) *
+           (c->num_sets - s->num_leaders) / s->num_sampled;
+  }
+  return est;
+}
+
+////////////////////////////////////////////////////////////////////
+// Per-core read (demand) hit rates, for shared caches
+////////////////////////////////////////////////////////////////////
+
+void    cache_print_core_stats(Cache *c, char *header, uns num_cores){
+  uns ii;
+  for(ii=0; ii<num_cores; ii++){
+    uns64 access = c->stat_core_read_access[ii];
+    uns64 hits   = access - c->stat_core_read_miss[ii];
+    printf("\n%s_CORE%u_READ_ACCESS\t\t : %10llu", header, ii, access);
+    printf("\n%s_CORE%u_READ_HITS  \t\t : %10llu", header, ii, hits);
+    printf("\n%s_CORE%u_READ_HITPERC\t\t : %10.3f", header, ii,
+           access ? 100.0*(double)hits/(double)access : 0.0);
+  }
+  if(c->repl_policy == REPL_TADIP || c->repl_policy == REPL_TADRRIP){
+    for(ii=0; ii<num_cores; ii++){
+      printf("\n%s_CORE%u_PSEL       \t\t : %10u", header, ii, c->ta_psel[ii]);
+    }
+  }
+  printf("\n");
+}
+
+////////////////////////////////////////////////////////////////////
+// SWP: lay the quotas out as consecutive way ranges. Without explicit
+// per-core quotas core 0 gets SWP_CORE0_WAYS and the other cores split
+// the remaining ways as evenly as possible.
+////////////////////////////////////////////////////////////////////
+
+static void swp_new(Cache *c){
+  uns ii, ways;
+  uns first = 0;
+  uns rest  = (SWP_CORE0_WAYS < c->num_ways) ? c->num_ways - SWP_CORE0_WAYS : 0;
+
+  for(ii=0; ii<NUM_CORES; ii++){
+    if(SWP_NUM_QUOTAS){
+      ways = SWP_WAYS[ii];
+    }
+    else if(ii == 0){
+      ways = SWP_CORE0_WAYS;
+    }
+    else{
+      ways = rest/(NUM_CORES-1) + (ii-1 < rest%(NUM_CORES-1));
+    }
+    c->swp_first[ii] = first;
+    c->swp_end[ii]   = first + ways;
+    first += ways;
+    if(ways == 0 || first > c->num_ways){
+      printf("SWP quotas must give every core at least one of the %llu ways\n", c->num_ways);
+      exit(-1);
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////
+// UCP: UMON monitoring, lookahead partitioning and enforcement
+////////////////////////////////////////////////////////////////////
+
+static void ucp_new(Cache *c){
+  Cache_UCP *u = (Cache_UCP *) calloc (1, sizeof (Cache_UCP));
+  uns ii;
+
+  assert(NUM_CORES <= MAX_CORES && NUM_CORES <= c->num_ways);
+  u->stride = c->num_sets/UCP_SAMPLED_SETS;
+  if(u->stride == 0){
+    u->stride = 1;
+  }
+  u->num_sampled = (c->num_sets + u->stride - 1)/u->stride;
+  u->atd = (Addr *) malloc (NUM_CORES * u->num_sampled * MAX_WAYS * sizeof(Addr));
+  for(ii=0; ii<NUM_CORES * u->num_sampled * MAX_WAYS; ii++){
+    u->atd[ii] = CACHE_KEY_INVALID;
+  }
+
+  // equal shares until the first epoch ends
+  for(ii=0; ii<NUM_CORES; ii++){
+    u->alloc[ii] = c->num_ways/NUM_CORES + (ii < c->num_ways%NUM_CORES);
+  }
+  u->next_epoch = UCP_EPOCH_CYCLES;
+  c->ucp = u;
+}
+
+// Lookahead: repeatedly give the core with the best hits-per-way over
+// any extension of its current share that many more ways.
+static void ucp_repartition(Cache *c){
+  Cache_UCP *u = c->ucp;
+  uns balance = c->num_ways - NUM_CORES;
+  uns ii, kk;
+
+  for(ii=0; ii<NUM_CORES; ii++){
+    u->alloc[ii] = 1;
+  }
+
+  while(balance){
+    uns    best_core = 0, best_ways = 1;
+    double best_mu = -1;
+    for(ii=0; ii<NUM_CORES; ii++){
+      uns64 hits = 0;
+      for(kk=1; kk<=balance; kk++){
+        hits += u->way_hits[ii][u->alloc[ii]+kk-1];
+        double mu = (double)hits/(double)kk;
+        if(mu > best_mu){
+          best_mu = mu;
+          best_core = ii;
+          best_ways = kk;
+        }
+      }
+    }
+    u->alloc[best_core] += best_ways;
+    balance -= best_ways;
+  }
+
+  // halve the counters so older epochs fade out
+  for(ii=0; ii<NUM_CORES; ii++){
+    for(kk=0; kk<c->num_ways; kk++){
+      u->way_hits[ii][kk] /= 2;
+    }
+  }
+  u->stat_repartitions++;
+}
+
+static void ucp_monitor(Cache *c, uns set_index, Addr tag, uns core_id){
+  Cache_UCP *u = c->ucp;
+
+  if(cycle >= u->next_epoch){
+    ucp_repartition(c);
+    u->next_epoch = cycle + UCP_EPOCH_CYCLES;
+  }
+  if(set_index % u->stride){
+    return;
+  }
+
+  Addr *stack = &u->atd[(core_id*u->num_sampled + set_index/u->stride)*MAX_WAYS];
+  uns pos;
+  for(pos=0; pos<c->num_ways-1; pos++){
+    if(stack[pos] == tag){
+      break;
+    }
+  }
+  if(stack[pos] == tag){
+    u->way_hits[core_id][pos]++;
+  }
+  // move to MRU, a miss drops the LRU entry
+  for(; pos>0; pos--){
+    stack[pos] = stack[pos-1];
+  }
+  stack[0] = tag;
+}
+
+// Below its quota a core takes the LRU line of another core, at or
+// above it the core replaces its own LRU line. cache_find_victim has
+// already taken any empty way.
+static uns ucp_victim(Cache *c, uns set_index, uns core_id){
+  Cache_Set *set = &c->sets[set_index];
+  uns owned = 0, ii;
+
+  for(ii=0; ii<c->num_ways; ii++){
+    owned += ((set->key[ii] & 0xff) == core_id);
+  }
+
+  Flag take_own = (owned >= c->ucp->alloc[core_id]);
+  int  lru = -1;
+  for(ii=0; ii<c->num_ways; ii++){
+    Flag mine = ((set->key[ii] & 0xff) == core_id);
+    if(mine != take_own){
+      continue;
+    }
+    if(lru == -1 || set->last_access_time[ii] < set->last_access_time[lru]){
+      lru = ii;
+    }
+  }
+  assert(lru != -1);
+  return lru;
+}
+
 ////////////////////////////////////////////////////////////////////
 // Note: the system provides the cache with the line address
 // Return HIT if access hits in the cache, MISS otherwise 
@@ -74,49 +651,125 @@ Flag cache_access(Cache *c, Addr lineaddr, uns is_write, uns core_id){
   // Your Code Goes Here
   assert(c != NULL);
 
-  // get the log2 of the linesize, then we shift the addr over by that many and get the index
-  // then and with num_sets - 1, which should give us all the bits representing the index.
-  // uint32_t index = (lineaddr >> log2_int(CACHE_LINESIZE)) & (c->num_sets-1);
-  uint32_t index = lineaddr % c->num_sets;
+  Addr tag;
+  uint32_t index = cache_index_tag(c, lineaddr, &tag);
   assert(index < c->num_sets);
 
-  //uint32_t tag = (lineaddr >> (log2_int(CACHE_LINESIZE) + log2_int(c->num_sets)));
-  uint32_t tag = lineaddr / c->num_sets;
-  // printf("%x %x %x %u %u\n", lineaddr, index, tag, log2_int(CACHE_LINESIZE), log2_int(c->num_sets));
+  if (c->sample && !c->sample->map[index]) {
+    if (c->ucp && !is_write) {
+      ucp_monitor(c, index, tag, core_id);
+    }
+    return cache_sample_access(c, is_write, core_id);
+  }
 
   if (is_write) {
     c->stat_write_access++;
+    if (c->sample) {
+      c->sample->write_access[index]++;
+    }
   }
   else {
     c->stat_read_access++;
+    c->stat_core_read_access[core_id]++;
+    if (c->sample) {
+      c->sample->read_access[index]++;
+    }
   }
 
-  uint32_t i;
-  for(i=0; i<c->num_ways; i++)
-  {
-    // not sure whether tag is the address or just tag bits of address.
-    if(c->sets[index].line[i].valid && 
-      (c->sets[index].line[i].tag == tag) && 
-      (c->sets[index].line[i].core_id == core_id))
-    {
-      if (is_write) {
-        c->sets[index].line[i].dirty = 1;
-      }
-      c->sets[index].line[i].last_access_time = cycle;
-      return HIT;
+  // the UMONs watch demand accesses, writebacks carry no reuse
+  if (c->ucp && !is_write) {
+    ucp_monitor(c, index, tag, core_id);
+  }
+
+  // lines are private to a core: the key holds both tag and core_id
+  Cache_Set *set = &c->sets[index];
+  uns match = cache_match_ways(c, set, CACHE_KEY(tag, CACHE_KEY_CORE(c, core_id)));
+  if (c->sample && c->sample->map[index] == CACHE_SAMPLE_RANDOM) {
+    cache_sample_observe(is_write ? &c->sample->ratio_write[core_id] : &c->sample->ratio_read[core_id], !match);
+  }
+  if (match) {
+    uint32_t i = __builtin_ctz(match);
+    if (is_write) {
+      set->dirty |= 1u << i;
+      set->writer[i] = core_id;
     }
+    c->last_hit_prefetched = (set->prefetched >> i) & 1;
+    set->prefetched &= ~(1u << i);
+    set->last_access_time[i] = cycle;
+    cache_repl_touch(c, index, i);
+    return HIT;
   }
   
   if (is_write) {
     c->stat_write_miss++;
+    if (c->sample) {
+      c->sample->write_miss[index]++;
+    }
   }
   else {
     c->stat_read_miss++;
+    c->stat_core_read_miss[core_id]++;
+    if (c->sample) {
+      c->sample->read_miss[index]++;
+    }
   }
 
   return MISS;
 }
 
+////////////////////////////////////////////////////////////////////
+// Would lineaddr hit? Touches neither stats nor replacement state
+////////////////////////////////////////////////////////////////////
+
+Flag cache_probe(Cache *c, Addr lineaddr, uns core_id){
+  Addr tag;
+  uns  index = cache_index_tag(c, lineaddr, &tag);
+  if(c->sample && !c->sample->map[index]){
+    return (c->sample->credit_read[core_id] + c->sample->ratio_read[core_id] >= 1.0) ? MISS : HIT;
+  }
+  return cache_match_ways(c, &c->sets[index], CACHE_KEY(tag, CACHE_KEY_CORE(c, core_id))) ? HIT : MISS;
+}
+
+////////////////////////////////////////////////////////////////////
+// Coherence actions on a resident line, no-ops if it is not there.
+////////////////////////////////////////////////////////////////////
+
+Flag cache_invalidate(Cache *c, Addr lineaddr, uns core_id){
+  Addr tag;
+  uns  index = cache_index_tag(c, lineaddr, &tag);
+  Cache_Set *set = &c->sets[index];
+  uns  match = cache_match_ways(c, set, CACHE_KEY(tag, CACHE_KEY_CORE(c, core_id)));
+
+  if(!match){
+    return FALSE;
+  }
+  Flag dirty = (set->dirty & match) != 0;
+  set->valid      &= ~match;
+  set->dirty      &= ~match;
+  set->prefetched &= ~match;
+  set->key[__builtin_ctz(match)] = CACHE_KEY_INVALID;
+  set->last_access_time[__builtin_ctz(match)] = 0;
+  return dirty;
+}
+
+Flag cache_clean(Cache *c, Addr lineaddr, uns core_id){
+  Addr tag;
+  uns  index = cache_index_tag(c, lineaddr, &tag);
+  Cache_Set *set = &c->sets[index];
+  uns  match = cache_match_ways(c, set, CACHE_KEY(tag, CACHE_KEY_CORE(c, core_id)));
+  Flag dirty = (set->dirty & match) != 0;
+
+  set->dirty &= ~match;
+  return dirty;
+}
+
+Flag cache_dirty(Cache *c, Addr lineaddr, uns core_id){
+  Addr tag;
+  uns  index = cache_index_tag(c, lineaddr, &tag);
+  Cache_Set *set = &c->sets[index];
+  return (set->dirty & cache_match_ways(c, set, CACHE_KEY(tag, CACHE_KEY_CORE(c, core_id)))) != 0;
+}
+
 ////////////////////////////////////////////////////////////////////
 // Note: the system provides the cache with the line address
 // Install the line: determine victim using repl policy (LRU/RAND)
@@ -128,13 +781,14 @@ void cache_install(Cache *c, Addr lineaddr, uns is_write, uns core_id){
 
   // Your Code Goes Here
 
-  // 16-1 = 15 = 1111 which is the mask we want.
-  // uint32_t index = (lineaddr >> log2_int(CACHE_LINESIZE)) & (c->num_sets-1); 
-  uint32_t index = lineaddr % c->num_sets;
+  Addr tag;
+  uint32_t index = cache_index_tag(c, lineaddr, &tag);
   assert(index < c->num_sets);
 
-  // uint32_t tag = (lineaddr >> (log2_int(CACHE_LINESIZE) + log2_int(c->num_sets)));
-  uint32_t tag = lineaddr / c->num_sets;
+  if (c->sample && !c->sample->map[index]) {
+    cache_sample_install(c, lineaddr, index, core_id);
+    return;
+  }
 
   // Find victim using cache_find_victim
   uint32_t victim = cache_find_victim(c, index, core_id);
@@ -142,17 +796,123 @@ void cache_install(Cache *c, Addr lineaddr, uns is_write, uns core_id){
 
   // we are evicting it, so check if it is dirty
   // Initialize the evicted entry
-  if ( c->sets[index].line[victim].dirty ) {
+  Cache_Set *set = &c->sets[index];
+  uns bit = 1u << victim;
+  Cache_Line *evict = &c->last_evicted_line;
+  evict->valid = (set->valid & bit) != 0;
+  evict->dirty = (set->dirty & bit) != 0;
+  evict->tag = evict->valid ? set->key[victim] >> 8 : 0;
+  // a shared cache keys every line with core 0; writebacks go to the writer
+  evict->core_id = evict->valid ? (c->shared ? set->writer[victim] : (uns)(set->key[victim] & 0xff)) : 0;
+  evict->last_access_time = set->last_access_time[victim];
+  evict->prefetched = evict->valid && (set->prefetched & bit);
+  if ( evict->dirty ) {
     c->stat_dirty_evicts++;
   }
-  c->last_evicted_line = c->sets[index].line[victim];
+  if (c->sample && c->sample->map[index] == CACHE_SAMPLE_RANDOM) {
+    cache_sample_observe(&c->sample->ratio_dirty, evict->dirty);
+  }
+  else if (c->sample && evict->dirty) {
+    c->sample->stat_leader_dirty_evicts++;
+  }
+  c->last_evicted_lineaddr = cache_lineaddr(c, evict->tag, index);
 
   // Initialize the victime entry
-  c->sets[index].line[victim].valid = 1;
-  c->sets[index].line[victim].dirty = is_write;
-  c->sets[index].line[victim].tag = tag;
-  c->sets[index].line[victim].core_id = core_id;
-  c->sets[index].line[victim].last_access_time = cycle; // defined at top of file for this reason
+  assert(core_id <= 0xff);
+  set->valid |= bit;
+  set->dirty = is_write ? (set->dirty | bit) : (set->dirty & ~bit);
+  set->prefetched &= ~bit;
+  set->writer[victim] = core_id;
+  set->key[victim] = CACHE_KEY(tag, CACHE_KEY_CORE(c, core_id));
+  set->last_access_time[victim] = cycle; // defined at top of file for this reason
+  cache_repl_fill(c, index, victim, core_id);
+  c->last_install_set = index;
+  c->last_install_way = victim;
+}
+
+void cache_mark_prefetched(Cache *c){
+  c->sets[c->last_install_set].prefetched |= 1u << c->last_install_way;
+}
+
+////////////////////////////////////////////////////////////////////
+// Age-stack LRU: 16 4-bit ages in one word, updated with SWAR. Even
+// and odd nibbles are spread into byte lanes so each lane has a spare
+// high bit to compare with.
+////////////////////////////////////////////////////////////////////
+
+#define LANE_LO   0x0F0F0F0F0F0F0F0FULL
+#define LANE_HI   0x8080808080808080ULL
+#define LANE_ONE  0x0101010101010101ULL
+
+static inline uns64 age_inc_below(uns64 lanes, uns age){
+  // +1 in every byte lane holding a value < age
+  return lanes + ((~((lanes | LANE_HI) - LANE_ONE*age) & LANE_HI) >> 7);
+}
+
+static inline uns64 age_make_mru(uns64 ages, uns way){
+  uns   age  = (ages >> (4*way)) & 15;
+  uns64 even = age_inc_below(ages & LANE_LO, age);
+  uns64 odd  = age_inc_below((ages >> 4) & LANE_LO, age);
+  return ((even | (odd << 4)) & ~(15ULL << (4*way)));
+}
+
+// Way whose age is 'age' (exactly one way has each age)
+static inline uns age_find(uns64 ages, uns age){
+  uns64 x    = ages ^ (0x1111111111111111ULL * age);
+  uns64 even = ~((x & LANE_LO) + 0x7F7F7F7F7F7F7F7FULL) & LANE_HI;
+  uns64 odd  = ~(((x >> 4) & LANE_LO) + 0x7F7F7F7F7F7F7F7FULL) & LANE_HI;
+  if(even){
+    return 2*(__builtin_ctzll(even)/8);
+  }
+  return 2*(__builtin_ctzll(odd)/8) + 1;
+}
+
+////////////////////////////////////////////////////////////////////
+// Tree PLRU: node bits in heap order (root is bit 1), a set bit points
+// to the right subtree as the one to evict from. For way counts that
+// are not a power of two the walk steers around missing ways.
+////////////////////////////////////////////////////////////////////
+
+static inline uns plru_touch(Cache *c, uns bits, uns way){
+  uns node = 1;
+  int lvl;
+  for(lvl = c->plru_levels-1; lvl >= 0; lvl--){
+    uns right = (way >> lvl) & 1;
+    bits = right ? (bits & ~(1u << node)) : (bits | (1u << node));
+    node = 2*node + right;
+  }
+  return bits;
+}
+
+static inline uns plru_victim(Cache *c, uns bits){
+  uns node = 1, way = 0;
+  int lvl;
+  for(lvl = c->plru_levels-1; lvl >= 0; lvl--){
+    uns right = (bits >> node) & 1;
+    if(right && ((2*way+1) << lvl) >= c->num_ways){
+      right = 0;
+    }
+    way  = 2*way + right;
+    node = 2*node + right;
+  }
+  return way;
+}
+
+////////////////////////////////////////////////////////////////////
+// RRIP: evict the first way at RRIP_MAX. If there is none, age every
+// way by the same amount in one add so the oldest reaches RRIP_MAX.
+////////////////////////////////////////////////////////////////////
+
+static inline uns rrip_victim(Cache *c, Cache_Set *set){
+  uns r   = set->rrpv;
+  uns max = r & (r >> 1) & c->rrpv_lo;
+  if(!max){
+    uns age = (r & (c->rrpv_lo << 1)) ? 1 : ((r & c->rrpv_lo) ? 2 : 3);
+    r += age * c->rrpv_lo;
+    set->rrpv = r;
+    max = r & (r >> 1) & c->rrpv_lo;
+  }
+  return __builtin_ctz(max)/2;
 }
 
 ////////////////////////////////////////////////////////////////////
@@ -163,6 +923,14 @@ void cache_install(Cache *c, Addr lineaddr, uns is_write, uns core_id){
 uns cache_find_victim(Cache *c, uns set_index, uns core_id){
   uns victim=0;
 
+  // Empty ways (cold or invalidated) fill before anything is evicted,
+  // whatever the replacement state says. SWP looks in the core's own
+  // partition itself.
+  uns holes = ~c->sets[set_index].valid & c->way_mask;
+  if (holes && c->repl_policy != REPL_SWP) {
+    return __builtin_ctz(holes);
+  }
+
   if (c->repl_policy == 0) {
     int lru = -1;
     uint64_t oldest;
@@ -170,10 +938,10 @@ uns cache_find_victim(Cache *c, uns set_index, uns core_id){
     int i;
     for(i=0; i<c->num_ways; i++)
     {
-      if(lru == -1 || (c->sets[set_index].line[i].last_access_time < oldest))
+      if(lru == -1 || (c->sets[set_index].last_access_time[i] < oldest))
       {
         lru = i;
-        oldest = c->sets[set_index].line[i].last_access_time;
+        oldest = c->sets[set_index].last_access_time[i];
       }
     }
 
@@ -188,32 +956,38 @@ uns cache_find_victim(Cache *c, uns set_index, uns core_id){
     uint64_t oldest;
 
     // hopefully it is as easy as this. 
-    int start, end;
-    if (core_id == 0) {
-      start = 0;
-      end = SWP_CORE0_WAYS;
-    }
-    else {
-      start = SWP_CORE0_WAYS;
-      end = c->num_ways;
-    }
+    int start = c->swp_first[core_id];
+    int end   = c->swp_end[core_id];
     
     int i;
     for(i=start; i<end; i++)
     {
-      if(!c->sets[set_index].line[i].valid)
+      if(!(c->sets[set_index].valid & (1u << i)))
       {
         return i;
       }
-      else if(lru == -1 || (c->sets[set_index].line[i].last_access_time < oldest))
+      else if(lru == -1 || (c->sets[set_index].last_access_time[i] < oldest))
       {
         lru = i;
-        oldest = c->sets[set_index].line[i].last_access_time;
+        oldest = c->sets[set_index].last_access_time[i];
       }
     }
 
     victim = lru;
   }
+  else if(c->repl_policy == REPL_UCP) {
+    victim = ucp_victim(c, set_index, core_id);
+  }
+  else if(c->repl_policy == REPL_AGELRU || c->repl_policy == REPL_TADIP) {
+    victim = age_find(c->sets[set_index].ages, c->num_ways-1);
+  }
+  else if(c->repl_policy == REPL_PLRU) {
+    victim = plru_victim(c, c->sets[set_index].plru);
+  }
+  else if((c->repl_policy >= REPL_SRRIP && c->repl_policy <= REPL_DRRIP) ||
+          c->repl_policy == REPL_TADRRIP) {
+    victim = rrip_victim(c, &c->sets[set_index]);
+  }
   else {
     assert(0);
     fprintf(stderr, "got policy did not expect\n");
@@ -222,3 +996,93 @@ uns cache_find_victim(Cache *c, uns set_index, uns core_id){
   return victim;
 }
 
+////////////////////////////////////////////////////////////////////
+// Replacement state update on a hit (touch) and on an install (fill).
+// Timestamp LRU and SWP only use last_access_time, set by the caller.
+////////////////////////////////////////////////////////////////////
+
+void cache_repl_touch(Cache *c, uns set_index, uns way){
+  Cache_Set *set = &c->sets[set_index];
+
+  switch(c->repl_policy){
+  case REPL_AGELRU:
+  case REPL_TADIP:
+    set->ages = age_make_mru(set->ages, way);
+    break;
+  case REPL_PLRU:
+    set->plru = plru_touch(c, set->plru, way);
+    break;
+  case REPL_SRRIP:
+  case REPL_BRRIP:
+  case REPL_DRRIP:
+  case REPL_TADRRIP:
+    set->rrpv &= ~(3u << (2*way));  // hit priority: predict near re-use
+    break;
+  }
+}
+
+// Thread-aware set dueling: core i leads with the non-bimodal policy in
+// sets at offset 2i of every drrip_stride sets and with the bimodal one at
+// 2i+1. Its misses there steer its own PSEL, everywhere else it follows it.
+static Flag cache_ta_bimodal(Cache *c, uns set_index, uns core_id){
+  uns  leader = set_index % c->drrip_stride;
+  uns *psel   = &c->ta_psel[core_id];
+
+  if(leader == 2*core_id){
+    if(*psel < DRRIP_PSEL_MAX) (*psel)++;
+    return FALSE;
+  }
+  if(leader == 2*core_id+1){
+    if(*psel > 0) (*psel)--;
+    return TRUE;
+  }
+  return (*psel > (DRRIP_PSEL_MAX+1)/2);
+}
+
+void cache_repl_fill(Cache *c, uns set_index, uns way, uns core_id){
+  Cache_Set *set = &c->sets[set_index];
+  uns brrip = (c->repl_policy == REPL_BRRIP);
+
+  if(c->repl_policy == REPL_DRRIP){
+    // every fill is a miss: leader set misses steer PSEL
+    uns leader = set_index % c->drrip_stride;
+    if(leader == 0){
+      if(c->drrip_psel < DRRIP_PSEL_MAX) c->drrip_psel++;
+    }
+    else if(leader == c->drrip_stride/2){
+      if(c->drrip_psel > 0) c->drrip_psel--;
+      brrip = TRUE;
+    }
+    else{
+      brrip = (c->drrip_psel > (DRRIP_PSEL_MAX+1)/2);
+    }
+  }
+  else if(c->repl_policy == REPL_TADIP || c->repl_policy == REPL_TADRRIP){
+    brrip = cache_ta_bimodal(c, set_index, core_id);
+  }
+
+  switch(c->repl_policy){
+  case REPL_AGELRU:
+  case REPL_PLRU:
+    cache_repl_touch(c, set_index, way);
+    break;
+  case REPL_TADIP:
+    // the victim was the LRU way, bimodal fills mostly stay there
+    if(!(brrip && (c->brrip_fills++ % BRRIP_LONG_EVERY))){
+      set->ages = age_make_mru(set->ages, way);
+    }
+    break;
+  case REPL_SRRIP:
+  case REPL_BRRIP:
+  case REPL_DRRIP:
+  case REPL_TADRRIP: {
+    uns rrpv = RRIP_MAX-1;
+    if(brrip && (c->brrip_fills++ % BRRIP_LONG_EVERY)){
+      rrpv = RRIP_MAX;
+    }
+    set->rrpv = (set->rrpv & ~(3u << (2*way))) | (rrpv << (2*way));
+    break;
+  }
+  }
+}
+
@@ -3,38 +3,195 @@
 
 #include "types.h"
 
-#define MAX_WAYS 16
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE4_1__)
+#include <smmintrin.h>
+#endif
+
+#define MAX_WAYS 16   // keep a multiple of 4, tag match reads 4 ways at a time
+
+// Replacement policies (-repl for L1, -L2repl for L2)
+#define REPL_LRU      0   // timestamp LRU, full scan for the victim
+#define REPL_RND      1
+#define REPL_SWP      2   // static way partitioning (SWP_core0ways)
+#define REPL_UCP      3
+#define REPL_AGELRU   4   // true LRU, 4-bit age per way in one word
+#define REPL_PLRU     5   // tree pseudo-LRU
+#define REPL_SRRIP    6   // 2-bit RRIP, insert at long re-reference
+#define REPL_BRRIP    7   // 2-bit RRIP, mostly insert at distant
+#define REPL_DRRIP    8   // set dueling between SRRIP and BRRIP
+#define REPL_TADIP    9   // thread-aware DIP: MRU or bimodal insertion, per-core PSEL
+#define REPL_TADRRIP  10  // thread-aware DRRIP, per-core PSEL
+
+#define RRIP_MAX          3
+#define BRRIP_LONG_EVERY  32   // BRRIP inserts at RRIP_MAX-1 once per 32 fills
+#define DRRIP_LEADERS     32   // leader sets per policy
+#define DRRIP_PSEL_MAX    1023
+
+#define UCP_SAMPLED_SETS  32        // sets watched by each core's UMON
+#define UCP_EPOCH_CYCLES  5000000     // repartition interval
+
+// Lookup key of a resident line: tag and owning core, all-ones when invalid
+#define CACHE_KEY(tag, core_id)  (((Addr)(tag) << 8) | (core_id))
+#define CACHE_KEY_INVALID        (~(Addr)0)
+// in a shared cache (-shared) lines match whichever core asks
+#define CACHE_KEY_CORE(c, core_id)  ((c)->shared ? 0 : (core_id))
 
 typedef struct Cache_Line Cache_Line;
 typedef struct Cache_Set Cache_Set;
 typedef struct Cache Cache;
+typedef struct Prefetcher Prefetcher;
+
+// How a line address is split into set index and tag, picked at cache_new
+typedef enum Cache_Index_Mode_Enum {
+    CACHE_INDEX_POW2=0,   // num_sets is a power of two: shift and mask
+    CACHE_INDEX_RECIP=1,  // otherwise: multiply by a precomputed reciprocal
+} Cache_Index_Mode;
 
 //////////////////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////////////
 
 
+// Unpacked view of one way, used for last_evicted_line
 struct Cache_Line {
     Flag    valid;
     Flag    dirty;
     Addr    tag;
     uns     core_id;
     uns    last_access_time; // for LRU
+    Flag    prefetched;      // brought in by a prefetch, never used
    // Note: No data as we are only estimating hit/miss 
 };
 
 
+// Ways are stored as parallel arrays so all keys of a set are contiguous
+// (16 ways = 128 bytes) and a hit is found with a few vector compares.
 struct Cache_Set {
-    Cache_Line line[MAX_WAYS];
+    Addr    key[MAX_WAYS];              // CACHE_KEY(tag, core_id)
+    uns     last_access_time[MAX_WAYS]; // for LRU
+    uns     valid;                      // bit per way
+    uns     dirty;                      // bit per way
+    uns     prefetched;                 // bit per way: prefetched, not used yet
+    uns8    writer[MAX_WAYS];           // shared caches: core that filled or last wrote it
+
+    // replacement state, only the one for repl_policy is used
+    uns64   ages;   // REPL_AGELRU: nibble per way, 0 is MRU
+    uns     plru;   // REPL_PLRU: tree node bits, heap order from bit 1
+    uns     rrpv;   // REPL_*RRIP: 2 bits per way
 };
 
 
+// Utility-based cache partitioning: one auxiliary tag directory (ATD)
+// per core over sampled sets, kept in LRU stack order as if the core
+// had the whole cache. Hits per stack position give each core's
+// marginal utility of one more way.
+typedef struct Cache_UCP {
+  uns   stride;                         // every stride-th set is sampled
+  uns   num_sampled;
+  Addr *atd;                            // [core][sampled set][way], MRU first
+  uns64 way_hits[MAX_CORES][MAX_WAYS];  // UMON hit counters per stack position
+  uns   alloc[MAX_CORES];               // ways each core may fill per set
+  uns64 next_epoch;
+
+  uns64 stat_repartitions;
+} Cache_UCP;
+
+
+// Miss status holding registers: one per line with a fill in flight.
+// An entry is free again once cycle reaches its ready_cycle.
+typedef struct Cache_MSHR {
+  Addr  lineaddr;
+  uns64 ready_cycle;
+} Cache_MSHR;
+
+
+// Write-back buffer: dirty victims on their way to the next level,
+// drained one after the other. An entry is free again once cycle
+// reaches its done_cycle.
+typedef struct Cache_WBB_Entry {
+  Addr  lineaddr;
+  uns64 done_cycle;
+} Cache_WBB_Entry;
+
+
+#define CACHE_SAMPLE_EMA  256  // modeled events averaged into each ratio
+
+#define CACHE_SAMPLE_SKIP    0  // not modeled, charged from the ratios
+#define CACHE_SAMPLE_RANDOM  1  // picked by hash, the ratios come from these
+#define CACHE_SAMPLE_LEADER  2  // set-dueling leader, always modeled
+
+// Set sampling: only the RANDOM and LEADER sets in map are modeled.
+// Accesses to the others are charged a hit or miss so that the charged
+// misses track the recent miss ratio of the core in the RANDOM sets
+// (error diffusion), and an install there evicts a dirty line at the
+// modeled rate. The leaders are modeled so that PSEL sees every update
+// it would in a full run; they are counted in full and the RANDOM sets
+// estimate the rest (two strata). The modeled sets keep demand counts
+// for the confidence interval of the estimate.
+typedef struct Cache_Sample {
+  uns8  *map;               // per set: CACHE_SAMPLE_*
+  uns    num_sampled;       // RANDOM sets
+  uns    num_leaders;       // LEADER sets
+  uns64 *read_access;       // per set, modeled sets only
+  uns64 *read_miss;
+  uns64 *write_access;
+  uns64 *write_miss;
+  double ratio_read[MAX_CORES];  // moving averages over the modeled sets
+  double ratio_write[MAX_CORES];
+  double ratio_dirty;            // dirty victims per install
+  double credit_read[MAX_CORES]; // error diffusion, one per ratio
+  double credit_write[MAX_CORES];
+  double credit_dirty;
+
+  uns64  stat_read_access;  // accesses to the other sets
+  uns64  stat_write_access;
+  uns64  stat_read_miss;    // ... charged as misses
+  uns64  stat_write_miss;
+  uns64  stat_dirty_evicts;
+  uns64  stat_leader_dirty_evicts; // modeled, in LEADER sets
+} Cache_Sample;
+
+
 struct Cache{
   uns64 num_sets;
   uns64 num_ways;
   uns64 repl_policy;
+  Flag  shared;     // lines are not private to a core (-shared)
+  uns   way_mask;   // one bit per way
+  uns   rrpv_lo;    // low bit of each way's 2-bit RRPV lane
+  uns   plru_levels;
+  uns   drrip_stride; // DRRIP leader spacing in sets
+  uns   drrip_psel;   // > half: SRRIP leaders miss more, followers use BRRIP
+  uns   ta_psel[MAX_CORES]; // TADIP/TADRRIP: same, one per core
+  uns   brrip_fills;
+  uns   swp_first[MAX_CORES]; // SWP: core i fills ways [swp_first, swp_end)
+  uns   swp_end[MAX_CORES];
+
+  Cache_Index_Mode index_mode;
+  uns   set_shift;  // log2(num_sets), POW2 mode
+  uns64 set_mask;   // num_sets-1, POW2 mode
+  uns64 set_recip;  // floor((2^64-1)/num_sets), RECIP mode
   
+  Cache_UCP *ucp;   // only for REPL_UCP
+
+  Cache_MSHR *mshr; // NULL: blocking cache
+  uns   num_mshrs;
+
+  Cache_Sample *sample; // NULL: every set is modeled
+
+  Cache_WBB_Entry *wbb; // NULL: victims written back right away
+  uns   num_wbb;
+  uns64 wbb_drain_free;   // the next queued writeback may start here
+
+  Prefetcher *pf;   // NULL: demand fetch only
+  Flag  last_hit_prefetched;  // last cache_access hit a prefetched line
+  uns   last_install_set;     // where the last cache_install put its line
+  uns   last_install_way;
+
   Cache_Set *sets;
   Cache_Line last_evicted_line; // for checking writebacks
+  Addr  last_evicted_lineaddr;  // line address of last_evicted_line
 
   //stats
   uns64 stat_read_access; 
@@ -42,6 +199,17 @@ struct Cache{
   uns64 stat_read_miss; 
   uns64 stat_write_miss; 
   uns64 stat_dirty_evicts; // how many dirty lines were evicted?
+  uns64 stat_core_read_access[MAX_CORES];
+  uns64 stat_core_read_miss[MAX_CORES];
+  uns64 stat_mshr_alloc;      // primary misses
+  uns64 stat_mshr_merge;      // secondary misses merged into an entry
+  uns64 stat_mshr_full;       // primary misses that waited for an entry
+  uns64 stat_mshr_full_wait;  // ... and the cycles they waited
+  uns64 stat_mshr_occupancy;  // sum of busy entries seen at each alloc
+  uns64 stat_wbb_writebacks;  // victims queued
+  uns64 stat_wbb_coalesced;   // ... merged with a queued one instead
+  uns64 stat_wbb_full;        // victims that waited for an entry
+  uns64 stat_wbb_full_wait;   // ... and the cycles their fill waited
 };
 
 
@@ -50,10 +218,87 @@ struct Cache{
 
 Cache  *cache_new(uns64 size, uns64 assocs, uns64 linesize, uns64 repl_policy);
 Flag    cache_access         (Cache *c, Addr lineaddr, uns is_write, uns core_id);
+Flag    cache_probe          (Cache *c, Addr lineaddr, uns core_id); // no side effects
 void    cache_install        (Cache *c, Addr lineaddr, uns is_write, uns core_id);
 void    cache_print_stats    (Cache *c, char *header);
+void    cache_print_core_stats(Cache *c, char *header, uns num_cores);
+
+void    cache_mark_prefetched(Cache *c); // the line of the last install
+Flag    cache_invalidate     (Cache *c, Addr lineaddr, uns core_id); // TRUE if it was dirty
+Flag    cache_clean          (Cache *c, Addr lineaddr, uns core_id); // TRUE if it was dirty
+Flag    cache_dirty          (Cache *c, Addr lineaddr, uns core_id); // no side effects
+
+void    cache_mshr_init      (Cache *c, uns num_mshrs);
+uns64   cache_mshr_merge     (Cache *c, Addr lineaddr, uns64 delay);
+uns64   cache_mshr_alloc     (Cache *c);
+void    cache_mshr_fill      (Cache *c, Addr lineaddr, uns64 ready_cycle);
+
+void    cache_wbb_init       (Cache *c, uns num_wbb);
+void    cache_sample_init    (Cache *c, uns sample);
+double  cache_sample_estimate(Cache *c, Flag with_writes, uns64 *access, double *err);
+uns64   cache_sample_dirty_evicts(Cache *c);
+Flag    cache_sample_skip    (Cache *c, Addr lineaddr, uns is_write);
+Flag    cache_wbb_coalesce   (Cache *c, Addr lineaddr, uns64 when);
+uns64   cache_wbb_alloc      (Cache *c, uns64 when);
+void    cache_wbb_fill       (Cache *c, Addr lineaddr, uns64 done_cycle);
 
 uns     cache_find_victim    (Cache *c, uns set_index, uns core_id);
+void    cache_repl_touch     (Cache *c, uns set_index, uns way);
+void    cache_repl_fill      (Cache *c, uns set_index, uns way, uns core_id);
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+// Split lineaddr into set index and tag without a 64-bit divide. In RECIP
+// mode the high half of lineaddr*set_recip is floor(lineaddr/num_sets) or
+// one less, so a single correction step makes it exact for any lineaddr.
+//////////////////////////////////////////////////////////////////////////////////////////////
+
+static inline uns cache_index_tag(Cache *c, Addr lineaddr, Addr *tag){
+  if(c->index_mode == CACHE_INDEX_POW2){
+    *tag = lineaddr >> c->set_shift;
+    return (uns)(lineaddr & c->set_mask);
+  }
+
+  Addr  q = (Addr)(((unsigned __int128)lineaddr * c->set_recip) >> 64);
+  uns64 r = lineaddr - q*c->num_sets;
+  if(r >= c->num_sets){
+    q++;
+    r -= c->num_sets;
+  }
+  *tag = q;
+  return (uns)r;
+}
+
+// Bitmask of the ways of set s holding key (at most one bit is set)
+static inline uns cache_match_ways(Cache *c, Cache_Set *s, Addr key){
+  uns mask = 0;
+  uns ii;
+#if defined(__AVX2__)
+  __m256i k = _mm256_set1_epi64x((long long)key);
+  for(ii=0; ii<c->num_ways; ii+=4){
+    __m256i v = _mm256_loadu_si256((const __m256i *)&s->key[ii]);
+    mask |= (uns)_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(v, k))) << ii;
+  }
+#elif defined(__SSE4_1__)
+  __m128i k = _mm_set1_epi64x((long long)key);
+  for(ii=0; ii<c->num_ways; ii+=2){
+    __m128i v = _mm_loadu_si128((const __m128i *)&s->key[ii]);
+    mask |= (uns)_mm_movemask_pd(_mm_castsi128_pd(_mm_cmpeq_epi64(v, k))) << ii;
+  }
+#else
+  for(ii=0; ii<c->num_ways; ii++){
+    mask |= (uns)(s->key[ii] == key) << ii;
+  }
+#endif
+  return mask & c->way_mask;
+}
+
+// Inverse of cache_index_tag
+static inline Addr cache_lineaddr(Cache *c, Addr tag, uns set_index){
+  if(c->index_mode == CACHE_INDEX_POW2){
+    return (tag << c->set_shift) | set_index;
+  }
+  return tag*c->num_sets + set_index;
+}
 
 //////////////////////////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////////////////////
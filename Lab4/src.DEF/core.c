@@ -7,7 +7,9 @@
 
 #include "core.h"
 
-extern uns64 cycle;
+extern __thread uns64 cycle;
+extern Flag  TRACE_PREFETCH;
+extern uns64 CORE_WINDOW;
 
 extern void die_message(const char * msg);
 
@@ -21,6 +23,11 @@ Core *core_new(Memsys *memsys, char *trace_fname, uns core_id)
   c->core_id = core_id;
   c->memsys  = memsys;
 
+  if(CORE_WINDOW){
+    c->load_ready = (uns64 *) calloc (CORE_WINDOW, sizeof(uns64));
+    c->load_inst  = (uns64 *) calloc (CORE_WINDOW, sizeof(uns64));
+  }
+
   strcpy(c->trace_fname, trace_fname);
   core_init_trace(c);
   core_read_trace(c);
@@ -31,16 +38,91 @@ Core *core_new(Memsys *memsys, char *trace_fname, uns core_id)
 
 ////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////
+// The trace is decompressed in-process and decoded a block of records
+// at a time. With TRACE_PREFETCH a helper thread decodes the next block
+// while the simulator consumes the current one.
+////////////////////////////////////////////////////////////////////
+
+static void core_fill_block(gzFile trace, Trace_Block *b){
+  int bytes = gzread(trace, b->raw, sizeof(b->raw));
+  uns ii;
+
+  b->num_recs = (bytes > 0) ? (uns)bytes/TRACE_REC_BYTES : 0;
+  for(ii=0; ii<b->num_recs; ii++){
+    uns8 *p = &b->raw[ii*TRACE_REC_BYTES];
+    memcpy(&b->rec[ii].inst_addr, p, 4);
+    b->rec[ii].inst_type = p[4];
+    memcpy(&b->rec[ii].ldst_addr, p+5, 4);
+  }
+}
+
+static void *core_prefetch_main(void *arg){
+  Core *c = (Core *) arg;
+  core_fill_block(c->trace, c->block[!c->cur_block]);
+  return NULL;
+}
+
+static void core_start_prefetch(Core *c){
+  if(TRACE_PREFETCH && c->block[c->cur_block]->num_recs == TRACE_BLOCK_RECS){
+    c->prefetching = (pthread_create(&c->prefetch_thread, NULL, core_prefetch_main, c) == 0);
+  }
+}
+
 void core_init_trace(Core *c)
 {
-  char  command_string[512];
-  
-  sprintf(command_string,"gunzip -c %s", c->trace_fname);
-  if ((c->trace = popen(command_string, "r")) == NULL){
-    printf("Command string is %s\n", command_string);
-    die_message("Unable to open the file with gzip option \n");
+  if ((c->trace = gzopen(c->trace_fname, "rb")) == NULL){
+    printf("Trace file is %s\n", c->trace_fname);
+    die_message("Unable to open the trace file \n");
   }
-  
+  gzbuffer(c->trace, 256*1024);
+
+  c->block[0] = (Trace_Block *) malloc (sizeof(Trace_Block));
+  c->block[1] = (Trace_Block *) malloc (sizeof(Trace_Block));
+  c->cur_block = 0;
+  c->block_pos = 0;
+  core_fill_block(c->trace, c->block[0]);
+  core_start_prefetch(c);
+}
+
+////////////////////////////////////////////////////////////////////
+// Non-blocking loads (-window W): a load that misses does not stall the
+// core; the following instructions keep issuing (the trace has no
+// dependences) until the oldest unfinished load is W instructions back.
+// Returns TRUE if the core cannot issue this cycle.
+////////////////////////////////////////////////////////////////////
+
+static Flag core_window_stall(Core *c){
+  while(c->num_loads && c->load_ready[c->load_head] < cycle){
+    c->load_head = (c->load_head+1) % CORE_WINDOW;
+    c->num_loads--;
+  }
+
+  if(c->draining && !c->num_loads){
+    c->done=TRUE;
+    c->done_inst_count  = c->inst_count;
+    c->done_cycle_count = cycle;
+    return TRUE;
+  }
+
+  if(c->num_loads &&
+     (c->draining || c->inst_count+1 - c->load_inst[c->load_head] >= CORE_WINDOW)){
+    c->snooze_end_cycle = c->load_ready[c->load_head];
+    if(!c->draining){
+      c->stat_window_full_cycles += c->snooze_end_cycle - cycle + 1;
+    }
+    return TRUE;
+  }
+
+  return FALSE;
+}
+
+static void core_window_push(Core *c, uns64 ready){
+  uns tail = (c->load_head + c->num_loads) % CORE_WINDOW;
+  c->stat_load_misses++;
+  c->stat_loads_inflight += c->num_loads;
+  c->load_ready[tail] = ready;
+  c->load_inst[tail]  = c->inst_count;
+  c->num_loads++;
 }
 
 ////////////////////////////////////////////////////////////////////
@@ -57,10 +139,15 @@ void core_cycle (Core *c)
       return;
   }
 
+  if(CORE_WINDOW && core_window_stall(c)){
+    return;
+  }
+
   c->inst_count++;
 
   uns ifetch_delay=0, ld_delay=0, st_delay=0, bubble_cycles=0;
 	
+  c->memsys->inst_pc[c->core_id] = c->trace_inst_addr;
   ifetch_delay = memsys_access(c->memsys, c->trace_inst_addr, ACCESS_TYPE_IFETCH, c->core_id);
   if(ifetch_delay>1){
     bubble_cycles += (ifetch_delay-1);
@@ -70,7 +157,12 @@ void core_cycle (Core *c)
     ld_delay = memsys_access(c->memsys, c->trace_ldst_addr, ACCESS_TYPE_LOAD, c->core_id);
   }
   if(ld_delay>1){
-    bubble_cycles += (ld_delay-1);
+    if(CORE_WINDOW){
+      core_window_push(c, cycle + ld_delay-1);
+    }
+    else{
+      bubble_cycles += (ld_delay-1);
+    }
   }
   
   if(c->trace_inst_type==INST_TYPE_STORE){
@@ -90,13 +182,37 @@ void core_cycle (Core *c)
 ////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////
 
+static void core_advance_block(Core *c){
+  if(c->prefetching){
+    pthread_join(c->prefetch_thread, NULL);
+    c->prefetching = FALSE;
+  }
+  else{
+    core_fill_block(c->trace, c->block[!c->cur_block]);
+  }
+  c->cur_block = !c->cur_block;
+  c->block_pos = 0;
+  core_start_prefetch(c);
+}
+
 void core_read_trace (Core *c){
-  uns tmp;
-  tmp = fread (&c->trace_inst_addr, 4, 1, c->trace);
-  tmp = fread (&c->trace_inst_type, 1, 1, c->trace);
-  tmp = fread (&c->trace_ldst_addr, 4, 1, c->trace);
-  
-  if(feof(c->trace)){
+  Trace_Block *b = c->block[c->cur_block];
+
+  if(c->block_pos == b->num_recs && b->num_recs == TRACE_BLOCK_RECS){
+    core_advance_block(c);
+    b = c->block[c->cur_block];
+  }
+
+  if(c->block_pos < b->num_recs){
+    Trace_Rec *r = &b->rec[c->block_pos++];
+    c->trace_inst_addr = r->inst_addr;
+    c->trace_inst_type = r->inst_type;
+    c->trace_ldst_addr = r->ldst_addr;
+  }
+  else if(c->num_loads){
+    c->draining=TRUE;  // done once the loads in flight return
+  }
+  else{
     c->done=TRUE;
     c->done_inst_count  = c->inst_count;
     c->done_cycle_count = cycle;
@@ -104,6 +220,27 @@ void core_read_trace (Core *c){
   
 }
 
+////////////////////////////////////////////////////////////////////
+// For callers that consume the trace a block at a time instead of
+// through core_cycle (-sweep), on a Core set up by core_init_trace
+// alone: the next unread block, NULL at the end. The block stays valid
+// until the next call.
+////////////////////////////////////////////////////////////////////
+
+Trace_Block *core_next_block(Core *c){
+  Trace_Block *b = c->block[c->cur_block];
+
+  if(c->block_pos == b->num_recs){
+    if(b->num_recs < TRACE_BLOCK_RECS){
+      return NULL;
+    }
+    core_advance_block(c);
+    b = c->block[c->cur_block];
+  }
+  c->block_pos = b->num_recs;
+  return b->num_recs ? b : NULL;
+}
+
 ////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////
 
@@ -117,8 +254,19 @@ void core_print_stats(Core *c)
   printf("\n%s_INST         \t\t : %10llu", header,  c->done_inst_count);
   printf("\n%s_CYCLES       \t\t : %10llu", header,  c->done_cycle_count);
   printf("\n%s_IPC          \t\t : %10.3f", header,  ipc);
+  if(CORE_WINDOW){
+    printf("\n%s_WINDOW_FULL_CYCLES\t : %10llu", header,  c->stat_window_full_cycles);
+    printf("\n%s_LOAD_MLP     \t\t : %10.3f", header,
+           c->stat_load_misses ? 1.0 + (double)c->stat_loads_inflight/(double)c->stat_load_misses : 0.0);
+  }
 
-  pclose(c->trace);
+  if(c->prefetching){
+    pthread_join(c->prefetch_thread, NULL);
+    c->prefetching = FALSE;
+  }
+  gzclose(c->trace);
+  free(c->block[0]);
+  free(c->block[1]);
 }
 
 
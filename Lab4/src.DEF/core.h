@@ -1,11 +1,30 @@
 #ifndef CORE_H
 #define CORE_H
 
+#include <pthread.h>
+#include <zlib.h>
+
 #include "types.h"
 #include "memsys.h"
 
 typedef struct Core Core;
 
+#define TRACE_REC_BYTES    9      // 4B inst addr, 1B type, 4B ldst addr
+#define TRACE_BLOCK_RECS   16384
+
+typedef struct Trace_Rec {
+  uns32 inst_addr;
+  uns32 ldst_addr;
+  uns8  inst_type;
+} Trace_Rec;
+
+// One decoded chunk of the trace; only the last block is short
+typedef struct Trace_Block {
+  Trace_Rec rec[TRACE_BLOCK_RECS];
+  uns       num_recs;
+  uns8      raw[TRACE_BLOCK_RECS*TRACE_REC_BYTES];
+} Trace_Block;
+
 
 
 ////////////////////////////////////////////////////////////////////////////
@@ -18,7 +37,13 @@ struct Core {
   Memsys *memsys;
     
   char  trace_fname[1024];
-  FILE *trace;
+  gzFile trace;
+
+  Trace_Block *block[2];   // current block and the one being prefetched
+  uns   cur_block;
+  uns   block_pos;         // next record in block[cur_block]
+  pthread_t prefetch_thread;
+  Flag  prefetching;       // prefetch_thread is filling block[!cur_block]
     
   uns   done;
 
@@ -28,9 +53,20 @@ struct Core {
   
   uns64 snooze_end_cycle; // when waiting for data to return
 
+  // -window: loads that missed retire in order once their data is back
+  uns64 *load_ready;      // ring of CORE_WINDOW: last cycle of each load
+  uns64 *load_inst;       // ... and its instruction number
+  uns   load_head;
+  uns   num_loads;
+  Flag  draining;         // trace ended, waiting for loads in flight
+
   uns64 inst_count;
   uns64 done_inst_count;
   uns64 done_cycle_count;
+
+  uns64 stat_window_full_cycles;  // stalled with the oldest load W insts back
+  uns64 stat_loads_inflight;      // sum of loads in flight seen by each miss
+  uns64 stat_load_misses;         // loads that went into the window
 };
 
 
@@ -43,6 +79,7 @@ void   core_cycle(Core *core);
 void   core_print_stats(Core *c);
 void   core_read_trace(Core *c);
 void   core_init_trace(Core *c);
+Trace_Block *core_next_block(Core *c);
 
 //////////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////
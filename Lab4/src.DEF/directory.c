@@ -0,0 +1,84 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "directory.h"
+
+#define DIR_FREE   (~0U)
+
+
+////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////
+
+static void dir_alloc(Directory *d, uns64 size){
+  uns64 ii;
+  d->size = size;
+  d->entries = (Dir_Entry *) calloc (size, sizeof(Dir_Entry));
+  for(ii=0; ii<size; ii++){
+    d->entries[ii].sharers = DIR_FREE;
+  }
+}
+
+Directory *dir_new(void){
+  Directory *d = (Directory *) calloc (1, sizeof (Directory));
+  dir_alloc(d, 4096);
+  return d;
+}
+
+static uns64 dir_slot(Directory *d, Addr lineaddr){
+  uns64 slot = ((lineaddr * 0x9E3779B97F4A7C15ULL) >> 32) & (d->size-1);
+  while(d->entries[slot].sharers != DIR_FREE && d->entries[slot].lineaddr != lineaddr){
+    slot = (slot+1) & (d->size-1);
+  }
+  return slot;
+}
+
+// Entries are never removed: a line no L1 holds keeps sharers == 0
+Dir_Entry *dir_lookup(Directory *d, Addr lineaddr){
+  uns64 slot = dir_slot(d, lineaddr);
+
+  if(d->entries[slot].sharers != DIR_FREE){
+    return &d->entries[slot];
+  }
+
+  if(2*(d->num+1) > d->size){
+    Dir_Entry *old = d->entries;
+    uns64 old_size = d->size, ii;
+    dir_alloc(d, 2*old_size);
+    for(ii=0; ii<old_size; ii++){
+      if(old[ii].sharers != DIR_FREE){
+        d->entries[dir_slot(d, old[ii].lineaddr)] = old[ii];
+      }
+    }
+    free(old);
+    slot = dir_slot(d, lineaddr);
+  }
+
+  Dir_Entry *e = &d->entries[slot];
+  memset(e, 0, sizeof(Dir_Entry));
+  e->lineaddr = lineaddr;
+  d->num++;
+  return e;
+}
+
+////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////
+
+void    dir_print_stats(Directory *d, uns num_cores){
+  uns ii;
+
+  printf("\nDIR_LINES              \t\t : %10llu", d->num);
+  printf("\nDIR_READ_FORWARDS      \t\t : %10llu", d->stat_read_forwards);
+  printf("\nDIR_DOWNGRADES         \t\t : %10llu", d->stat_downgrades);
+  printf("\nDIR_DOWNGRADE_WBS      \t\t : %10llu", d->stat_downgrade_wbs);
+  printf("\nDIR_UPGRADES           \t\t : %10llu", d->stat_upgrades);
+  printf("\nDIR_RFO_INVALIDATING   \t\t : %10llu", d->stat_rfo_invalidating);
+  printf("\nDIR_INVALIDATIONS      \t\t : %10llu", d->stat_invalidations);
+  printf("\nDIR_DIRTY_TRANSFERS    \t\t : %10llu", d->stat_dirty_transfers);
+  printf("\nDIR_EVICT_NOTICES      \t\t : %10llu", d->stat_evict_notices);
+  for(ii=0; ii<num_cores; ii++){
+    printf("\nDIR_DELAY_CORE%u        \t\t : %10llu", ii, d->stat_delay[ii]);
+  }
+  printf("\n");
+}
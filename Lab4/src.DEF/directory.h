@@ -0,0 +1,48 @@
+#ifndef DIRECTORY_H
+#define DIRECTORY_H
+
+#include "types.h"
+
+#define COH_MESI   0
+#define COH_MOESI  1
+
+//////////////////////////////////////////////////////////////////
+// -shared: a directory at the L2 with an entry for every line that
+// has been in an L1 data cache. It records which cores hold the line
+// and, with one holder, whether that copy is exclusive (E or M; the
+// L1 dirty bit tells which). Under MOESI a core that had the line in
+// M and was read by another core keeps it dirty as the owner (O)
+// and supplies it.
+//////////////////////////////////////////////////////////////////
+
+typedef struct Dir_Entry {
+  Addr  lineaddr;
+  uns   sharers;     // bit per core
+  Flag  exclusive;   // the one sharer may write without asking
+  uns   owner;       // MOESI: core+1 holding the line in O, 0: none
+} Dir_Entry;
+
+typedef struct Directory {
+  Dir_Entry *entries;   // open addressing on lineaddr, sharers of a free slot are ~0
+  uns64 size;           // power of two, kept at least twice num
+  uns64 num;
+
+  uns64 stat_read_forwards;   // read misses served by another core's E/M/O copy
+  uns64 stat_downgrades;      // E/M copies that became S (or O) on a read
+  uns64 stat_downgrade_wbs;   // MESI: M copies written back to the L2 on a read
+  uns64 stat_upgrades;        // stores to an S/O copy
+  uns64 stat_rfo_invalidating;// store misses that invalidated other copies
+  uns64 stat_invalidations;   // copies invalidated
+  uns64 stat_dirty_transfers; // ... that were dirty
+  uns64 stat_evict_notices;   // L1 evictions removed from the directory
+  uns64 stat_delay[MAX_CORES];// coherence cycles charged to each core
+} Directory;
+
+//////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////
+
+Directory *dir_new(void);
+Dir_Entry *dir_lookup(Directory *d, Addr lineaddr); // adds an empty entry if needed
+void    dir_print_stats(Directory *d, uns num_cores);
+
+#endif // DIRECTORY_H
@@ -1,11 +1,11 @@
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "dram.h"
 
 #define ROWBUF_SIZE         1024
-#define DRAM_BANKS          16
 
 //---- Latency for Part B ------
 
@@ -18,9 +18,29 @@
 #define DRAM_T_PRE         45
 #define DRAM_T_BUS         10
 
+//---- Extra timing for the -dramctl controller ------
+
+#define DRAM_T_RAS         100  // ACTIVATE to PRECHARGE
+#define DRAM_T_WTR         20   // bus turnaround from a write to a read
+#define DRAM_T_RTRS        5    // bus turnaround between ranks
+
+#define MAX(a,b)           ((a) > (b) ? (a) : (b))
+
 
 extern MODE   SIM_MODE;
 extern uns64  CACHE_LINESIZE;
+extern uns64  DRAM_CHANNELS;
+extern uns64  DRAM_RANKS;
+extern uns64  DRAM_BANKS;     // per rank
+extern uns64  DRAM_ADDR_MAP;
+extern Flag   DRAM_CTL;
+extern uns64  DRAM_PAGE_POLICY;
+extern uns64  DRAM_SCHED;
+extern uns64  DRAM_WQ_SIZE;
+
+extern __thread uns64 cycle;
+
+static uns64 dram_ctl_access(DRAM *dram, Addr lineaddr, Flag is_write, uns core_id);
 
 
 ///////////////////////////////////////////////////////////////////
@@ -28,7 +48,11 @@ extern uns64  CACHE_LINESIZE;
 
 DRAM   *dram_new(){
   DRAM *dram = (DRAM *) calloc (1, sizeof (DRAM));
-  assert(DRAM_BANKS <= MAX_DRAM_BANKS);
+  assert(DRAM_CHANNELS <= MAX_DRAM_CHANNELS);
+  assert(DRAM_CHANNELS*DRAM_RANKS*DRAM_BANKS <= MAX_DRAM_BANKS);
+  if(DRAM_CTL){
+    dram->wq = (Dram_Wq_Entry *) calloc (DRAM_WQ_SIZE, sizeof(Dram_Wq_Entry));
+  }
   return dram;
 }
 
@@ -54,15 +78,46 @@ void    dram_print_stats(DRAM *dram){
   printf("\n%s_READ_DELAY_AVG\t\t : %10.3f", header, rddelay_avg);
   printf("\n%s_WRITE_DELAY_AVG\t\t : %10.3f", header, wrdelay_avg);
 
+  if(DRAM_CTL && SIM_MODE!=SIM_MODE_B){
+    uns ii;
+    printf("\n%s_ROW_HITS       \t\t : %10llu", header, dram->stat_row_hit);
+    printf("\n%s_ROW_EMPTY      \t\t : %10llu", header, dram->stat_row_empty);
+    printf("\n%s_ROW_CONFLICTS  \t\t : %10llu", header, dram->stat_row_conflict);
+    printf("\n%s_WQ_DRAINS      \t\t : %10llu", header, dram->stat_wq_drains);
+    printf("\n%s_WQ_FORWARDS    \t\t : %10llu", header, dram->stat_wq_forwards);
+    for(ii=0; ii<DRAM_CHANNELS; ii++){
+      printf("\n%s_CH%u_BUS_UTIL_PERC\t\t : %10.3f", header, ii,
+             cycle ? 100.0*(double)dram->channel[ii].stat_bus_busy/(double)cycle : 0.0);
+    }
+    for(ii=0; ii<MAX_CORES; ii++){
+      uns64 reads = dram->stat_core_reads[ii];
+      uns64 lines = reads + dram->stat_core_writes[ii];
+      if(!lines){
+        continue;
+      }
+      printf("\n%s_CORE%u_READS    \t\t : %10llu", header, ii, reads);
+      printf("\n%s_CORE%u_WRITES   \t\t : %10llu", header, ii, dram->stat_core_writes[ii]);
+      printf("\n%s_CORE%u_READ_DELAY_AVG\t : %10.3f", header, ii,
+             reads ? (double)dram->stat_core_read_delay[ii]/(double)reads : 0.0);
+      printf("\n%s_CORE%u_QUEUE_DELAY_AVG\t : %10.3f", header, ii,
+             reads ? (double)dram->stat_core_queue_delay[ii]/(double)reads : 0.0);
+      printf("\n%s_CORE%u_BYTES_PER_KCYC\t : %10.3f", header, ii,
+             cycle ? 1000.0*(double)(lines*CACHE_LINESIZE)/(double)cycle : 0.0);
+    }
+  }
 
 }
 
 ///////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////
 
-uns64   dram_access(DRAM *dram,Addr lineaddr, Flag is_dram_write){
+uns64   dram_access(DRAM *dram,Addr lineaddr, Flag is_dram_write, uns core_id){
   uns64 delay=DRAM_LATENCY_FIXED;
 
+  if(DRAM_CTL && SIM_MODE!=SIM_MODE_B){
+    return dram_ctl_access(dram, lineaddr, is_dram_write, core_id);
+  }
+
   if(SIM_MODE!=SIM_MODE_B){
     delay = dram_access_sim_rowbuf(dram, lineaddr, is_dram_write);
   }
@@ -84,48 +139,259 @@ uns64   dram_access(DRAM *dram,Addr lineaddr, Flag is_dram_write){
 // Modify the function below only if you are attempting Part C 
 ///////////////////////////////////////////////////////////////////
 
-static int first = 1;
-uns64   dram_access_sim_rowbuf(DRAM *dram, Addr lineaddr, Flag is_dram_write){
-  uns64 delay=0;
+// Splits a line address into the row and the index of its bank over all
+// channels and ranks. Consecutive lines share a row except under
+// LINE_CHANNEL, which spreads them over the channels first. With one
+// channel and rank this is [ which row in bank | bank id | which line in row ].
+static uns64 dram_map(Addr lineaddr, uns64 *row){
+  uns64 cols = ROWBUF_SIZE / CACHE_LINESIZE;
+  uns64 a = lineaddr;
+  uns64 channel, bank, rank;
+
+  if(DRAM_ADDR_MAP==DRAM_MAP_LINE_CHANNEL){
+    channel = a % DRAM_CHANNELS;
+    a = a / DRAM_CHANNELS / cols;
+  }
+  else{
+    a /= cols;
+    channel = a % DRAM_CHANNELS;
+    a /= DRAM_CHANNELS;
+  }
+  bank = a % DRAM_BANKS;
+  a /= DRAM_BANKS;
+  rank = a % DRAM_RANKS;
+  *row = a / DRAM_RANKS;
 
-  static int open_rows[DRAM_BANKS] = {-1};
-  if (first) {
-    int i;
-    for(i=0;i<DRAM_BANKS; i++) {
-      open_rows[i] = -1;
-    }
-    first = 0;
+  if(DRAM_ADDR_MAP==DRAM_MAP_XOR){
+    bank ^= *row % DRAM_BANKS;  // DRAM_BANKS is a power of two here
   }
+  return (channel*DRAM_RANKS + rank)*DRAM_BANKS + bank;
+}
 
-  // Assume a mapping with consecutive lines in the same row
-  // Assume a mapping with consecutive rowbufs in consecutive rows
+uns64   dram_bank_of(Addr lineaddr){
+  uns64 row;
+  return dram_map(lineaddr, &row);
+}
 
-  // I dont think we should mod with #dram banks
-  uns64 bank_index = (lineaddr / (ROWBUF_SIZE / CACHE_LINESIZE)) % DRAM_BANKS;
-  assert(bank_index < DRAM_BANKS);
-  // [ which row in bank | bank id | which line in row ]
+uns64   dram_bus_cycles(void){
+  return DRAM_T_BUS;
+}
 
-  uns64 row_buf_index = lineaddr / (ROWBUF_SIZE / CACHE_LINESIZE) / DRAM_BANKS;
-  // assert(row_buf_index < );
-  // [ which row in bank | bank id | which line in row ]
-  // its a weird number for sure.
+// Rows are looked up in shadow when it has an entry for the bank and in
+// the DRAM otherwise; the access then opens its row in shadow, or in the
+// DRAM if there is no shadow.
+static uns64 dram_rowbuf_delay(DRAM *dram, Addr lineaddr, Rowbuf_Entry *shadow){
+  uns64 delay=0;
+  uns64 row_buf_index;
+  uns64 bank_index = dram_map(lineaddr, &row_buf_index);
+  assert(bank_index < MAX_DRAM_BANKS);
 
   // You need to write this fuction to track open rows 
-  if(open_rows[bank_index] == row_buf_index) {
+  Rowbuf_Entry *rb = &dram->perbank_row_buf[bank_index];
+  if(shadow && shadow[bank_index].valid) {
+    rb = &shadow[bank_index];
+  }
+  if(rb->valid && rb->rowid == row_buf_index) {
     delay = DRAM_T_CAS + DRAM_T_BUS;
   }
-  else if(open_rows[bank_index] == -1) {
-    open_rows[bank_index] = row_buf_index;
+  else if(!rb->valid) {
     delay = DRAM_T_ACT + DRAM_T_CAS + DRAM_T_BUS;
   }
   else {
-    open_rows[bank_index] = row_buf_index;
     delay = DRAM_T_PRE + DRAM_T_ACT + DRAM_T_CAS + DRAM_T_BUS;
   }
 
+  rb = shadow ? &shadow[bank_index] : &dram->perbank_row_buf[bank_index];
+  rb->valid = TRUE;
+  rb->rowid = row_buf_index;
+
   // You will need to compute delay based on row hit/miss/empty
 
   return delay;
 }
 
+uns64   dram_access_sim_rowbuf(DRAM *dram, Addr lineaddr, Flag is_dram_write){
+  return dram_rowbuf_delay(dram, lineaddr, NULL);
+}
+
+static Dram_Channel *dram_channel_of(DRAM *dram, uns64 bank_index){
+  return &dram->channel[bank_index / (DRAM_RANKS*DRAM_BANKS)];
+}
+
+///////////////////////////////////////////////////////////////////
+// Delay dram_access would charge, for a caller that keeps the rows it
+// opened in its own shadow table instead of changing the DRAM state and
+// stats (used by -parallel core threads; clear shadow to resync).
+///////////////////////////////////////////////////////////////////
+
+uns64   dram_peek_delay(DRAM *dram, Addr lineaddr, Rowbuf_Entry *shadow){
+  if(SIM_MODE==SIM_MODE_B){
+    return DRAM_LATENCY_FIXED;
+  }
+  if(DRAM_CTL){
+    // add the backlog the bank and bus had at the last sync
+    uns64 row, bank_index = dram_map(lineaddr, &row);
+    uns64 busy = MAX(dram->bank[bank_index].ready, dram_channel_of(dram, bank_index)->bus_free);
+    uns64 wait = (busy > cycle) ? busy - cycle : 0;
+    if(DRAM_PAGE_POLICY==DRAM_PAGE_CLOSED){
+      return wait + DRAM_T_ACT + DRAM_T_CAS + DRAM_T_BUS;
+    }
+    return wait + dram_rowbuf_delay(dram, lineaddr, shadow);
+  }
+  return dram_rowbuf_delay(dram, lineaddr, shadow);
+}
+
+///////////////////////////////////////////////////////////////////
+// -dramctl: a controller with per-bank timing, a data bus per channel and
+// one write queue. Reads are timed when they arrive (the core is charged
+// right away), so they are served in arrival order behind whatever the
+// bank and bus already hold. Writes wait in the write queue: they go
+// out while the bus would otherwise idle, and when the queue fills it
+// is drained down to a quarter, stalling the reads behind it. Under
+// FR-FCFS the write picked is the oldest one to an open row, if any.
+///////////////////////////////////////////////////////////////////
+
+// Places one burst on the bank and bus timelines, no earlier than now.
+// Returns the cycle its data transfer ends; *service is the latency an
+// idle DRAM would have had with the same row state.
+static uns64 dram_ctl_schedule(DRAM *dram, Addr lineaddr, Flag is_write, uns64 now, uns64 *service){
+  uns64 row, bank_index = dram_map(lineaddr, &row);
+  uns   rank = (bank_index / DRAM_BANKS) % DRAM_RANKS;
+  Dram_Bank *bank = &dram->bank[bank_index];
+  Dram_Channel *ch = dram_channel_of(dram, bank_index);
+  Rowbuf_Entry *rb = &dram->perbank_row_buf[bank_index];
+  uns64 t = MAX(now, bank->ready);
+  uns64 cas, bus, data;
+
+  *service = DRAM_T_CAS + DRAM_T_BUS;
+  if(rb->valid && rb->rowid == row){
+    dram->stat_row_hit++;
+    cas = t;
+  }
+  else{
+    if(rb->valid){
+      dram->stat_row_conflict++;
+      t = MAX(t, bank->act_cycle + DRAM_T_RAS) + DRAM_T_PRE;
+      *service += DRAM_T_PRE;
+    }
+    else{
+      dram->stat_row_empty++;
+    }
+    *service += DRAM_T_ACT;
+    bank->act_cycle = t;
+    cas = t + DRAM_T_ACT;
+    rb->valid = TRUE;
+    rb->rowid = row;
+  }
+
+  bus = ch->bus_free;
+  if(ch->bus_write && !is_write){
+    bus += DRAM_T_WTR;
+  }
+  else if(ch->bus_rank != rank){
+    bus += DRAM_T_RTRS;
+  }
+  data = MAX(cas + DRAM_T_CAS, bus);
+  ch->bus_free  = data + DRAM_T_BUS;
+  ch->bus_write = is_write;
+  ch->bus_rank  = rank;
+  ch->stat_bus_busy += DRAM_T_BUS;
+
+  // the next column command may follow this burst
+  bank->ready = data - DRAM_T_CAS + DRAM_T_BUS;
+  if(DRAM_PAGE_POLICY==DRAM_PAGE_CLOSED){
+    bank->ready = MAX(bank->ready, bank->act_cycle + DRAM_T_RAS) + DRAM_T_PRE;
+    rb->valid = FALSE;
+  }
+
+  return data + DRAM_T_BUS;
+}
+
+static uns dram_wq_pick(DRAM *dram){
+  uns ii;
+  if(DRAM_SCHED==DRAM_SCHED_FRFCFS){
+    for(ii=0; ii<dram->wq_num; ii++){
+      uns64 row, bank_index = dram_map(dram->wq[ii].lineaddr, &row);
+      Rowbuf_Entry *rb = &dram->perbank_row_buf[bank_index];
+      if(rb->valid && rb->rowid == row){
+        return ii;
+      }
+    }
+  }
+  return 0;  // the queue is kept oldest first
+}
+
+static uns64 dram_wq_drain_one(DRAM *dram, uns64 now){
+  uns ii = dram_wq_pick(dram);
+  Dram_Wq_Entry *w = &dram->wq[ii];
+  uns64 service;
+  uns64 done = dram_ctl_schedule(dram, w->lineaddr, TRUE, MAX(now, w->arrival), &service);
+
+  dram->stat_write_delay += done - w->arrival;
+  dram->wq_num--;
+  memmove(w, w+1, (dram->wq_num - ii)*sizeof(Dram_Wq_Entry));
+  return done;
+}
+
+// Reads return their latency. Writes return 0, or when the write queue
+// was full the cycles until the first drained write freed a slot.
+static uns64 dram_ctl_access(DRAM *dram, Addr lineaddr, Flag is_write, uns core_id){
+  uns64 now = cycle;
+  uns64 delay, service;
+  uns ii;
+
+  if(is_write){
+    dram->stat_write_access++;
+    dram->stat_core_writes[core_id]++;
+    for(ii=0; ii<dram->wq_num; ii++){
+      if(dram->wq[ii].lineaddr == lineaddr){
+        return 0;   // merged with the queued write
+      }
+    }
+    delay = 0;
+    if(dram->wq_num == DRAM_WQ_SIZE){
+      dram->stat_wq_drains++;
+      delay = dram_wq_drain_one(dram, now) - now;
+      while(dram->wq_num > DRAM_WQ_SIZE/4){
+        dram_wq_drain_one(dram, now);
+      }
+    }
+    dram->wq[dram->wq_num].lineaddr = lineaddr;
+    dram->wq[dram->wq_num].arrival  = now;
+    dram->wq[dram->wq_num].core_id  = core_id;
+    dram->wq_num++;
+    return delay;
+  }
+
+  // writes that fit in the idle bus time before this read
+  while(dram->wq_num){
+    uns64 row, bank_index = dram_map(dram->wq[0].lineaddr, &row);
+    uns64 start = MAX(dram_channel_of(dram, bank_index)->bus_free, dram->wq[0].arrival);
+    if(start + DRAM_T_PRE + DRAM_T_ACT + DRAM_T_CAS + DRAM_T_BUS > now){
+      break;
+    }
+    dram_wq_drain_one(dram, start);
+  }
+
+  delay = 0;
+  for(ii=0; ii<dram->wq_num; ii++){
+    if(dram->wq[ii].lineaddr == lineaddr){
+      dram->stat_wq_forwards++;
+      delay = DRAM_T_BUS;
+      service = delay;
+      break;
+    }
+  }
+  if(!delay){
+    delay = dram_ctl_schedule(dram, lineaddr, FALSE, now, &service) - now;
+  }
+
+  dram->stat_read_access++;
+  dram->stat_read_delay += delay;
+  dram->stat_core_reads[core_id]++;
+  dram->stat_core_read_delay[core_id]  += delay;
+  dram->stat_core_queue_delay[core_id] += delay - service;
+  return delay;
+}
+
 
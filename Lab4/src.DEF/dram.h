@@ -7,7 +7,20 @@
 
 #include "types.h"
 
-#define MAX_DRAM_BANKS          256
+#define MAX_DRAM_BANKS          256  // over all channels and ranks
+#define MAX_DRAM_CHANNELS       8
+
+// where the bank, channel and column bits of a line address come from,
+// low to high (see dram_map)
+#define DRAM_MAP_ROW_BANK_COL   0   // col | channel | bank | rank | row
+#define DRAM_MAP_XOR            1   // same, bank XORed with the low row bits
+#define DRAM_MAP_LINE_CHANNEL   2   // channel | col | bank | rank | row
+
+// -dramctl controller policies
+#define DRAM_PAGE_OPEN          0   // rows stay open until a conflict
+#define DRAM_PAGE_CLOSED        1   // auto-precharge after every burst
+#define DRAM_SCHED_FCFS         0
+#define DRAM_SCHED_FRFCFS       1   // row hits first, then oldest
 
 
 
@@ -24,14 +37,55 @@ struct Rowbuf_Entry {
 };
 
 
+// -dramctl: timing state of one bank. Commands are placed on each
+// bank's timeline as requests arrive; ready is the first cycle the next
+// one may issue.
+typedef struct Dram_Bank {
+  uns64 ready;
+  uns64 act_cycle;     // last ACTIVATE, a PRECHARGE waits for tRAS
+} Dram_Bank;
+
+// -dramctl: the data bus of one channel, shared by its ranks
+typedef struct Dram_Channel {
+  uns64 bus_free;      // busy until here
+  Flag  bus_write;     // direction of the last burst, for tWTR
+  uns   bus_rank;      // rank of the last burst, for tRTRS
+  uns64 stat_bus_busy; // cycles of data transfer
+} Dram_Channel;
+
+// a buffered write, drained to its bank later
+typedef struct Dram_Wq_Entry {
+  Addr  lineaddr;
+  uns64 arrival;
+  uns   core_id;
+} Dram_Wq_Entry;
+
+
 struct DRAM {
   Rowbuf_Entry perbank_row_buf[MAX_DRAM_BANKS];
+
+  // -dramctl controller
+  Dram_Bank     bank[MAX_DRAM_BANKS];
+  Dram_Channel  channel[MAX_DRAM_CHANNELS];
+  Dram_Wq_Entry *wq;
+  uns           wq_num;
   
    // stats 
   uns64 stat_read_access;
   uns64 stat_write_access;
   uns64 stat_read_delay;
   uns64 stat_write_delay;
+
+  uns64 stat_row_hit;
+  uns64 stat_row_empty;
+  uns64 stat_row_conflict;
+  uns64 stat_wq_drains;        // write-queue high watermark reached
+  uns64 stat_wq_forwards;      // reads served from the write queue
+
+  uns64 stat_core_reads[MAX_CORES];
+  uns64 stat_core_writes[MAX_CORES];
+  uns64 stat_core_read_delay[MAX_CORES];
+  uns64 stat_core_queue_delay[MAX_CORES]; // read delay beyond an idle DRAM's
 };
 
 
@@ -41,8 +95,11 @@ struct DRAM {
 
 DRAM   *dram_new();
 void    dram_print_stats(DRAM *dram);
-uns64   dram_access(DRAM *dram,Addr lineaddr, Flag is_dram_write);
+uns64   dram_access(DRAM *dram,Addr lineaddr, Flag is_dram_write, uns core_id);
 uns64   dram_access_sim_rowbuf(DRAM *dram,Addr lineaddr, Flag is_dram_write);
+uns64   dram_peek_delay(DRAM *dram, Addr lineaddr, Rowbuf_Entry *shadow);
+uns64   dram_bank_of(Addr lineaddr); // bank index over all channels and ranks
+uns64   dram_bus_cycles(void);       // data bus occupancy of one line
 
 
 
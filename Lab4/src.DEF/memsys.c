@@ -13,6 +13,16 @@
 #define DCACHE_HIT_LATENCY   1
 #define ICACHE_HIT_LATENCY   1
 #define L2CACHE_HIT_LATENCY  10
+#define L2TLB_HIT_LATENCY    7   // L1 TLB hits overlap the L1 cache lookup
+#define COH_INV_LATENCY      20  // directory to the sharers and back, sharers in parallel
+#define COH_FWD_LATENCY      20  // a line supplied by another core's L1
+
+//---- Page table (-tlb) ------
+
+#define PT_LEVELS            4   // x86-64 style radix tree, 9 index bits per level
+#define PT_LEVEL_ENTRIES     (1ULL << 20)  // PTEs per level table, enough for 32-bit VAs
+#define PT_PTE_BYTES         8
+#define PT_BASE_PFN          (1ULL << 36)  // page tables live past the data frames
 
 extern MODE   SIM_MODE;
 extern uns64  CACHE_LINESIZE;
@@ -26,8 +36,37 @@ extern uns64  L2CACHE_SIZE;
 extern uns64  L2CACHE_ASSOC;
 extern uns64  L2CACHE_REPL;
 extern uns64  NUM_CORES;
-
-extern uns64 cycle;
+extern uns64  L1_MSHRS;
+extern uns64  L2_MSHRS;
+extern uns64  L1_WBB_SIZE;
+extern uns64  L2_WBB_SIZE;
+extern uns64  CORE_WINDOW;
+extern uns64  L1_PREFETCHER;
+extern uns64  L2_PREFETCHER;
+extern uns64  PREFETCH_DEGREE;
+extern Flag   L2_MRC;
+extern uns64  L2_SAMPLE;
+extern Flag   TLB_ENABLE;
+extern uns64  L1TLB_ENTRIES;
+extern uns64  L1TLB_ASSOC;
+extern uns64  L2TLB_ENTRIES;
+extern uns64  L2TLB_ASSOC;
+extern uns64  PAGE_SIZE_KB;
+extern uns64  PAGE_ALLOC_POLICY;
+extern Flag   SHARED_MEM;
+extern uns64  COHERENCE;
+extern Flag   DRAM_CTL;
+
+extern __thread uns64 cycle;
+
+static uns64 memsys_L2_defer(Memsys *sys, Addr lineaddr, Flag is_writeback, uns core_id);
+static uns64 memsys_prefetch(Memsys *sys, Cache *c, Addr lineaddr, Flag outcome, uns64 delay, uns core_id);
+static uns64 memsys_writeback(Memsys *sys, Cache *c, uns64 when);
+static uns64 memsys_L1_access(Memsys *sys, Cache *c, Addr p_lineaddr, uns write, uns64 delay, uns core_id);
+static uns64 memsys_translate(Memsys *sys, Addr v_lineaddr, Flag is_ifetch, uns core_id);
+static void  memsys_print_tlb_stats(Memsys *sys, uns core_id);
+static uns64 memsys_coherence(Memsys *sys, Addr lineaddr, Flag write, uns core_id);
+static void  memsys_coherence_evict(Memsys *sys, Addr lineaddr, uns core_id);
 
 ////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////
@@ -37,6 +76,10 @@ Memsys *memsys_new(void)
 {
   Memsys *sys = (Memsys *) calloc (1, sizeof (Memsys));
 
+  // a blocking cache under a non-blocking core handles one miss at a time
+  uns64 l1_mshrs = (L1_MSHRS || !CORE_WINDOW) ? L1_MSHRS : 1;
+  uns64 l2_mshrs = (L2_MSHRS || !CORE_WINDOW) ? L2_MSHRS : 1;
+
   if(SIM_MODE==SIM_MODE_A){
     sys->dcache = cache_new(DCACHE_SIZE, DCACHE_ASSOC, CACHE_LINESIZE, REPL_POLICY);
   }
@@ -59,9 +102,68 @@ Memsys *memsys_new(void)
     sys->l2cache = cache_new(L2CACHE_SIZE, L2CACHE_ASSOC, CACHE_LINESIZE, L2CACHE_REPL);
     sys->dram    = dram_new();
     uns ii;
+    uns core_bits = 1;
+    while((1ULL << core_bits) < NUM_CORES){
+      core_bits++;
+    }
+    sys->pfn_head_shift = 21 + core_bits;
+    if(SHARED_MEM){
+      sys->l2cache->shared = TRUE;
+      sys->dir = dir_new();
+    }
+    if(PAGE_ALLOC_POLICY != PAGE_ALLOC_FIXED){
+      Cache *l2 = sys->l2cache;
+      uns l2_colors = (uns)(l2->num_sets*CACHE_LINESIZE/PAGE_SIZE);
+      sys->page_alloc = page_alloc_new(PAGE_ALLOC_POLICY, NUM_CORES, PAGE_SIZE/CACHE_LINESIZE, l2_colors);
+    }
     for(ii=0; ii<NUM_CORES; ii++){
       sys->dcache_coreid[ii] = cache_new(DCACHE_SIZE, DCACHE_ASSOC, CACHE_LINESIZE, REPL_POLICY);
       sys->icache_coreid[ii] = cache_new(ICACHE_SIZE, ICACHE_ASSOC, CACHE_LINESIZE, REPL_POLICY);
+      cache_mshr_init(sys->dcache_coreid[ii], l1_mshrs);
+      cache_mshr_init(sys->icache_coreid[ii], l1_mshrs);
+      cache_wbb_init(sys->dcache_coreid[ii], L1_WBB_SIZE);
+      if(TLB_ENABLE){
+        sys->itlb[ii]  = cache_new(L1TLB_ENTRIES, L1TLB_ASSOC, 1, REPL_LRU);
+        sys->dtlb[ii]  = cache_new(L1TLB_ENTRIES, L1TLB_ASSOC, 1, REPL_LRU);
+        sys->l2tlb[ii] = cache_new(L2TLB_ENTRIES, L2TLB_ASSOC, 1, REPL_LRU);
+      }
+    }
+  }
+
+  if((SIM_MODE==SIM_MODE_B)||(SIM_MODE==SIM_MODE_C)){
+    cache_mshr_init(sys->dcache, l1_mshrs);
+    cache_mshr_init(sys->icache, l1_mshrs);
+    cache_wbb_init(sys->dcache, L1_WBB_SIZE);
+  }
+  if(sys->l2cache){
+    cache_mshr_init(sys->l2cache, l2_mshrs);
+    cache_wbb_init(sys->l2cache, L2_WBB_SIZE);
+    if(L2_SAMPLE > 1){
+      cache_sample_init(sys->l2cache, L2_SAMPLE);
+    }
+  }
+
+  // prefetchers sit at the L1 data caches and at the L2 (not in Part A)
+  if(L1_PREFETCHER && (SIM_MODE!=SIM_MODE_A)){
+    uns ii;
+    if(sys->dcache){
+      sys->dcache->pf = prefetcher_new(L1_PREFETCHER, PREFETCH_DEGREE);
+    }
+    for(ii=0; ii<NUM_CORES && sys->dcache_coreid[ii]; ii++){
+      sys->dcache_coreid[ii]->pf = prefetcher_new(L1_PREFETCHER, PREFETCH_DEGREE);
+    }
+  }
+  if(L2_PREFETCHER && sys->l2cache){
+    sys->l2cache->pf = prefetcher_new(L2_PREFETCHER, PREFETCH_DEGREE);
+  }
+
+  if(L2_MRC && sys->l2cache){
+    sys->mrc_all = mrc_new();
+    if(sys->dcache_coreid[0] && NUM_CORES > 1){
+      uns ii;
+      for(ii=0; ii<NUM_CORES; ii++){
+        sys->mrc_core[ii] = mrc_new();
+      }
     }
   }
 
@@ -94,18 +196,18 @@ uns64 memsys_access(Memsys *sys, Addr addr, Access_Type type, uns core_id)
   
   //update the stats
   if(type==ACCESS_TYPE_IFETCH){
-    sys->stat_ifetch_access++;
-    sys->stat_ifetch_delay+=delay;
+    sys->stat_ifetch_access[core_id]++;
+    sys->stat_ifetch_delay[core_id]+=delay;
   }
 
   if(type==ACCESS_TYPE_LOAD){
-    sys->stat_load_access++;
-    sys->stat_load_delay+=delay;
+    sys->stat_load_access[core_id]++;
+    sys->stat_load_delay[core_id]+=delay;
   }
 
   if(type==ACCESS_TYPE_STORE){
-    sys->stat_store_access++;
-    sys->stat_store_delay+=delay;
+    sys->stat_store_access[core_id]++;
+    sys->stat_store_delay[core_id]+=delay;
   }
 
 
@@ -126,26 +228,47 @@ void memsys_print_stats(Memsys *sys)
   double load_delay_avg=0;
   double store_delay_avg=0;
 
-  if(sys->stat_ifetch_access){
-    ifetch_delay_avg = (double)(sys->stat_ifetch_delay)/(double)(sys->stat_ifetch_access);
+  uns64 ifetch_access=0, load_access=0, store_access=0;
+  uns64 ifetch_delay=0,  load_delay=0,  store_delay=0;
+  uns   core;
+  for(core=0; core<MAX_CORES; core++){
+    ifetch_access += sys->stat_ifetch_access[core];
+    load_access   += sys->stat_load_access[core];
+    store_access  += sys->stat_store_access[core];
+    ifetch_delay  += sys->stat_ifetch_delay[core];
+    load_delay    += sys->stat_load_delay[core];
+    store_delay   += sys->stat_store_delay[core];
+  }
+
+  if(ifetch_access){
+    ifetch_delay_avg = (double)(ifetch_delay)/(double)(ifetch_access);
   }
 
-  if(sys->stat_load_access){
-    load_delay_avg = (double)(sys->stat_load_delay)/(double)(sys->stat_load_access);
+  if(load_access){
+    load_delay_avg = (double)(load_delay)/(double)(load_access);
   }
 
-  if(sys->stat_store_access){
-    store_delay_avg = (double)(sys->stat_store_delay)/(double)(sys->stat_store_access);
+  if(store_access){
+    store_delay_avg = (double)(store_delay)/(double)(store_access);
   }
 
 
   printf("\n");
-  printf("\n%s_IFETCH_ACCESS  \t\t : %10llu",  header, sys->stat_ifetch_access);
-  printf("\n%s_LOAD_ACCESS    \t\t : %10llu",  header, sys->stat_load_access);
-  printf("\n%s_STORE_ACCESS   \t\t : %10llu",  header, sys->stat_store_access);
+  printf("\n%s_IFETCH_ACCESS  \t\t : %10llu",  header, ifetch_access);
+  printf("\n%s_LOAD_ACCESS    \t\t : %10llu",  header, load_access);
+  printf("\n%s_STORE_ACCESS   \t\t : %10llu",  header, store_access);
   printf("\n%s_IFETCH_AVGDELAY\t\t : %10.3f",  header, ifetch_delay_avg);
   printf("\n%s_LOAD_AVGDELAY  \t\t : %10.3f",  header, load_delay_avg);
   printf("\n%s_STORE_AVGDELAY \t\t : %10.3f",  header, store_delay_avg);
+  if(sys->par_log){
+    uns64 reads = sys->stat_par_l2_reads;
+    printf("\n%s_PAR_L2_READS   \t\t : %10llu",  header, reads);
+    printf("\n%s_PAR_L2_MISMATCH\t\t : %10llu",  header, sys->stat_par_l2_mismatch);
+    printf("\n%s_PAR_L2_MISMATCH_PERC\t : %10.3f",  header,
+           reads ? 100.0*(double)sys->stat_par_l2_mismatch/(double)reads : 0.0);
+    printf("\n%s_PAR_L2_DELAY_ERR_AVG\t : %10.3f",  header,
+           reads ? (double)sys->stat_par_l2_delay_err/(double)reads : 0.0);
+  }
   printf("\n");
 
    if(SIM_MODE==SIM_MODE_A){
@@ -155,17 +278,51 @@ void memsys_print_stats(Memsys *sys)
   if((SIM_MODE==SIM_MODE_B)||(SIM_MODE==SIM_MODE_C)){
     cache_print_stats(sys->icache, "ICACHE");
     cache_print_stats(sys->dcache, "DCACHE");
+    if(sys->dcache->pf){
+      prefetcher_print_stats(sys->dcache->pf, "DCACHE");
+    }
     cache_print_stats(sys->l2cache, "L2CACHE");
+    if(sys->l2cache->pf){
+      prefetcher_print_stats(sys->l2cache->pf, "L2CACHE");
+    }
+    if(sys->mrc_all){
+      mrc_print_stats(sys->mrc_all, "L2MRC", CACHE_LINESIZE);
+    }
     dram_print_stats(sys->dram);
   }
 
   if((SIM_MODE==SIM_MODE_D)||(SIM_MODE==SIM_MODE_E)||(SIM_MODE==SIM_MODE_F) ){
-    assert(NUM_CORES==2); //Hardcoded
-    cache_print_stats(sys->icache_coreid[0], "ICACHE_0");
-    cache_print_stats(sys->dcache_coreid[0], "DCACHE_0");
-    cache_print_stats(sys->icache_coreid[1], "ICACHE_1");
-    cache_print_stats(sys->dcache_coreid[1], "DCACHE_1");
+    uns ii;
+    for(ii=0; ii<NUM_CORES; ii++){
+      sprintf(header, "ICACHE_%u", ii);
+      cache_print_stats(sys->icache_coreid[ii], header);
+      sprintf(header, "DCACHE_%u", ii);
+      cache_print_stats(sys->dcache_coreid[ii], header);
+      if(sys->dcache_coreid[ii]->pf){
+        prefetcher_print_stats(sys->dcache_coreid[ii]->pf, header);
+      }
+      if(sys->itlb[ii]){
+        memsys_print_tlb_stats(sys, ii);
+      }
+    }
     cache_print_stats(sys->l2cache, "L2CACHE");
+    if(sys->l2cache->pf){
+      prefetcher_print_stats(sys->l2cache->pf, "L2CACHE");
+    }
+    cache_print_core_stats(sys->l2cache, "L2CACHE", NUM_CORES);
+    if(sys->page_alloc){
+      page_alloc_print_stats(sys->page_alloc);
+    }
+    if(sys->dir){
+      dir_print_stats(sys->dir, NUM_CORES);
+    }
+    if(sys->mrc_all){
+      mrc_print_stats(sys->mrc_all, "L2MRC_ALL", CACHE_LINESIZE);
+      for(ii=0; ii<NUM_CORES && sys->mrc_core[ii]; ii++){
+        sprintf(header, "L2MRC_CORE%u", ii);
+        mrc_print_stats(sys->mrc_core[ii], header, CACHE_LINESIZE);
+      }
+    }
     dram_print_stats(sys->dram);
     
   }
@@ -241,17 +398,26 @@ uns64 memsys_access_modeBC(Memsys *sys, Addr lineaddr, Access_Type type, uns cor
   }
 
   Flag outcome=cache_access(c, lineaddr, write, core_id);
+  if(outcome==HIT && c->mshr){
+    delay = cache_mshr_merge(c, lineaddr, delay);
+  }
   if(outcome==MISS){
-    delay += memsys_L2_access(sys, lineaddr, FALSE, core_id);
+    uns64 wait = c->mshr ? cache_mshr_alloc(c) : 0;
+    cycle += wait;  // the miss reaches the L2 once it has an MSHR
+    delay += wait + memsys_L2_access(sys, lineaddr, FALSE, core_id);
+    cycle -= wait;
     cache_install(c, lineaddr, write, core_id);
-
     if (c->last_evicted_line.dirty) {
-      uns64 victim_lineaddr = (c->last_evicted_line.tag * c->num_sets) | 
-                              (lineaddr % c->num_sets);
-
-      memsys_L2_access(sys, victim_lineaddr, TRUE, core_id);
+      delay += memsys_writeback(sys, c, cycle + delay);
+    }
+    if(c->mshr){
+      cache_mshr_fill(c, lineaddr, cycle + delay);
     }
   }
+
+  if(c->pf){
+    delay = memsys_prefetch(sys, c, lineaddr, outcome, delay, core_id);
+  }
  
   return delay;
 }
@@ -261,13 +427,15 @@ uns64 memsys_access_modeBC(Memsys *sys, Addr lineaddr, Access_Type type, uns cor
 // This function converts virtual page number (VPN) to physical frame
 // number (PFN).  Note, you will need additional operations to obtain
 // VPN from lineaddr and to get physical lineaddr using PFN. 
+// The core_id takes ceil(log2(NUM_CORES)) bits starting at bit 21, and
+// any VPN bits above the low 20 go above it (none with 32-bit traces).
 /////////////////////////////////////////////////////////////////////
 
 uns64 memsys_convert_vpn_to_pfn(Memsys *sys, uns64 vpn, uns core_id){
   uns64 tail = vpn & 0x000fffff;
   uns64 head = vpn >> 20;
-  uns64 pfn  = tail + (core_id << 21) + (head << 21);
-  assert(NUM_CORES==2); //We don't support more than two cores yet
+  uns64 pfn  = tail + ((uns64)core_id << 21) + (head << sys->pfn_head_shift);
+  assert(core_id < NUM_CORES);
   return pfn;
 }
 
@@ -289,6 +457,8 @@ uns64 memsys_access_modeDEF(Memsys *sys, Addr v_lineaddr, Access_Type type,uns c
   Cache* c;
   uns write;
   uns64 delay=0;
+  uns64 tlb_delay=0;
+  uns64 coh_delay=0;
   Addr p_lineaddr=0;
 
   // TODO: First convert lineaddr from virtual (v) to physical (p) using the
@@ -296,7 +466,8 @@ uns64 memsys_access_modeDEF(Memsys *sys, Addr v_lineaddr, Access_Type type,uns c
   // NOTE: VPN_to_PFN operates at page granularity and returns page addr
 
   uns64 vpn = (v_lineaddr / (PAGE_SIZE/CACHE_LINESIZE));
-  uns64 pfn = memsys_convert_vpn_to_pfn(sys, vpn, core_id);
+  uns64 pfn = sys->page_alloc ? page_alloc_pfn(sys->page_alloc, vpn, core_id)
+                              : memsys_convert_vpn_to_pfn(sys, vpn, core_id);
 
   uns64 offset = v_lineaddr & (PAGE_SIZE/CACHE_LINESIZE-1);
   assert(offset < (PAGE_SIZE/CACHE_LINESIZE));
@@ -305,6 +476,11 @@ uns64 memsys_access_modeDEF(Memsys *sys, Addr v_lineaddr, Access_Type type,uns c
   assert( (p_lineaddr & (PAGE_SIZE/CACHE_LINESIZE-1)) == 0);
   p_lineaddr |= offset;
 
+  // one address space for all cores: no per-core mapping
+  if(SHARED_MEM){
+    p_lineaddr = v_lineaddr;
+  }
+
   if(type == ACCESS_TYPE_IFETCH){
     c = sys->icache_coreid[core_id];
     delay = ICACHE_HIT_LATENCY;
@@ -328,22 +504,227 @@ uns64 memsys_access_modeDEF(Memsys *sys, Addr v_lineaddr, Access_Type type,uns c
     assert(0);
   }
 
+  // the cache access starts once the translation is known
+  if(sys->itlb[core_id]){
+    tlb_delay = memsys_translate(sys, v_lineaddr, type == ACCESS_TYPE_IFETCH, core_id);
+  }
+  if(sys->dir && type != ACCESS_TYPE_IFETCH){
+    coh_delay = memsys_coherence(sys, p_lineaddr, write, core_id);
+  }
+  cycle += tlb_delay;
+  delay = memsys_L1_access(sys, c, p_lineaddr, write, delay, core_id);
+  cycle -= tlb_delay;
+
+  return tlb_delay + coh_delay + delay;
+}
+
+/////////////////////////////////////////////////////////////////////
+// An access to a per-core L1 with a physical line address, delay is
+// the hit latency. Also used for the page walker's PTE loads.
+/////////////////////////////////////////////////////////////////////
+
+static uns64 memsys_L1_access(Memsys *sys, Cache *c, Addr p_lineaddr, uns write, uns64 delay, uns core_id){
   Flag outcome=cache_access(c, p_lineaddr, write, core_id);
+  if(outcome==HIT && c->mshr){
+    delay = cache_mshr_merge(c, p_lineaddr, delay);
+  }
   if(outcome==MISS){
-    delay += memsys_L2_access(sys, p_lineaddr, FALSE, core_id);
+    uns64 wait = c->mshr ? cache_mshr_alloc(c) : 0;
+    cycle += wait;  // the miss reaches the L2 once it has an MSHR
+    delay += wait + memsys_L2_access(sys, p_lineaddr, FALSE, core_id);
+    cycle -= wait;
     cache_install(c, p_lineaddr, write, core_id);
-
+    if (sys->dir && c->last_evicted_line.valid && c == sys->dcache_coreid[core_id]) {
+      memsys_coherence_evict(sys, c->last_evicted_lineaddr, core_id);
+    }
     if (c->last_evicted_line.dirty) {
-      uns64 victim_lineaddr = (c->last_evicted_line.tag * c->num_sets) | 
-                              (p_lineaddr % c->num_sets);
-
-      memsys_L2_access(sys, victim_lineaddr, TRUE, c->last_evicted_line.core_id);
+      delay += memsys_writeback(sys, c, cycle + delay);
+    }
+    if(c->mshr){
+      cache_mshr_fill(c, p_lineaddr, cycle + delay);
     }
   }
+
+  if(c->pf){
+    delay = memsys_prefetch(sys, c, p_lineaddr, outcome, delay, core_id);
+  }
  
   return delay;
 }
 
+/////////////////////////////////////////////////////////////////////
+// -shared: MESI (or MOESI) between the L1 data caches, kept by the
+// directory at the L2 before each load or store reaches the L1.
+//   load miss,  E/M elsewhere: that copy drops to S and supplies the
+//                 line; under MESI a dirty one is written to the L2
+//                 first, under MOESI it stays dirty as the owner (O)
+//   load miss,  O elsewhere:   the owner supplies the line
+//   store, S/O or miss:        every other copy is invalidated; a
+//                 store hit also asks the directory first (upgrade)
+// Forwards and invalidations are charged to the requesting core on
+// top of its L1 access, which still gets the data from the L2.
+/////////////////////////////////////////////////////////////////////
+
+static uns64 memsys_coherence(Memsys *sys, Addr lineaddr, Flag write, uns core_id){
+  Directory *d = sys->dir;
+  Dir_Entry *e = dir_lookup(d, lineaddr);
+  uns   me = 1u << core_id;
+  uns   others = e->sharers & ~me;
+  Flag  present = (cache_probe(sys->dcache_coreid[core_id], lineaddr, core_id) == HIT);
+  uns64 delay = 0;
+  uns   ii;
+
+  if(!write){
+    if(present){
+      return 0;
+    }
+    if(others && e->exclusive){
+      uns holder = __builtin_ctz(others);
+      Cache *hc = sys->dcache_coreid[holder];
+      if(cache_dirty(hc, lineaddr, holder)){
+        if(COHERENCE == COH_MOESI){
+          e->owner = holder+1;
+        }
+        else{
+          cache_clean(hc, lineaddr, holder);
+          memsys_L2_access(sys, lineaddr, TRUE, holder);
+          d->stat_downgrade_wbs++;
+        }
+      }
+      d->stat_downgrades++;
+      d->stat_read_forwards++;
+      delay = COH_FWD_LATENCY;
+    }
+    else if(e->owner){
+      d->stat_read_forwards++;
+      delay = COH_FWD_LATENCY;
+    }
+    e->exclusive = (others == 0);
+    e->sharers |= me;
+  }
+  else if(!(present && e->exclusive)){
+    if(others){
+      for(ii=0; others >> ii; ii++){
+        if((others >> ii) & 1){
+          if(cache_invalidate(sys->dcache_coreid[ii], lineaddr, ii)){
+            d->stat_dirty_transfers++;  // the data moves to the writer
+          }
+          d->stat_invalidations++;
+        }
+      }
+      delay = COH_INV_LATENCY;
+      if(!present){
+        d->stat_rfo_invalidating++;
+      }
+    }
+    if(present){
+      d->stat_upgrades++;
+      delay += L2CACHE_HIT_LATENCY;
+    }
+    e->sharers   = me;
+    e->exclusive = TRUE;
+    e->owner     = 0;
+  }
+
+  d->stat_delay[core_id] += delay;
+  return delay;
+}
+
+// An L1 data cache dropped the line; a dirty copy is written back as usual
+static void memsys_coherence_evict(Memsys *sys, Addr lineaddr, uns core_id){
+  Dir_Entry *e = dir_lookup(sys->dir, lineaddr);
+
+  e->sharers &= ~(1u << core_id);
+  if(e->owner == core_id+1){
+    e->owner = 0;
+  }
+  if(!e->sharers){
+    e->exclusive = FALSE;
+  }
+  sys->dir->stat_evict_notices++;
+}
+
+/////////////////////////////////////////////////////////////////////
+// -tlb: per-core L1 ITLB and DTLB and a unified L2 TLB, each a Cache
+// keyed by virtual page number. An L2 TLB miss walks the page table,
+// loading one PTE per level through the core's L1 D-cache, one after
+// the other: four levels for 4KB pages, three for 2MB pages. Each
+// level's table is laid out linearly by virtual address (as if its
+// nodes had been allocated contiguously) in a per-core region past the
+// data frames, so neighboring pages share PTE lines. The frames
+// themselves still come from memsys_convert_vpn_to_pfn.
+/////////////////////////////////////////////////////////////////////
+
+static Addr memsys_pte_lineaddr(uns level, Addr va, uns core_id){
+  Addr index = (va >> (12 + 9*(level-1))) & (PT_LEVEL_ENTRIES-1);
+  Addr base  = (PT_BASE_PFN*PAGE_SIZE) + (Addr)core_id*PT_LEVELS*PT_LEVEL_ENTRIES*PT_PTE_BYTES;
+  Addr pte   = base + (level-1)*PT_LEVEL_ENTRIES*PT_PTE_BYTES + index*PT_PTE_BYTES;
+  return pte / CACHE_LINESIZE;
+}
+
+static uns64 memsys_page_walk(Memsys *sys, Addr va, uns page_shift, uns core_id){
+  Cache *c = sys->dcache_coreid[core_id];
+  uns leaf = (page_shift - 12)/9 + 1;
+  uns64 delay = 0;
+  uns level;
+
+  for(level=PT_LEVELS; level>=leaf; level--){
+    cycle += delay;
+    uns64 pte_delay = memsys_L1_access(sys, c, memsys_pte_lineaddr(level, va, core_id),
+                                       FALSE, DCACHE_HIT_LATENCY, core_id);
+    cycle -= delay;
+    delay += pte_delay;
+    sys->stat_walk_pte_loads[core_id]++;
+  }
+  sys->stat_walks[core_id]++;
+  sys->stat_walk_cycles[core_id] += delay;
+  return delay;
+}
+
+static uns64 memsys_translate(Memsys *sys, Addr v_lineaddr, Flag is_ifetch, uns core_id){
+  uns   page_shift = (PAGE_SIZE_KB == 2048) ? 21 : 12;
+  Addr  va    = v_lineaddr * CACHE_LINESIZE;
+  Addr  vpage = va >> page_shift;
+  Cache *l1   = is_ifetch ? sys->itlb[core_id] : sys->dtlb[core_id];
+  uns64 delay;
+
+  if(cache_access(l1, vpage, FALSE, core_id) == HIT){
+    return 0;
+  }
+  delay = L2TLB_HIT_LATENCY;
+  if(cache_access(sys->l2tlb[core_id], vpage, FALSE, core_id) == MISS){
+    cycle += delay;
+    delay += memsys_page_walk(sys, va, page_shift, core_id);
+    cycle -= L2TLB_HIT_LATENCY;
+    cache_install(sys->l2tlb[core_id], vpage, FALSE, core_id);
+  }
+  cache_install(l1, vpage, FALSE, core_id);
+  sys->stat_tlb_delay[core_id] += delay;
+  return delay;
+}
+
+static void memsys_print_tlb_stats(Memsys *sys, uns core_id){
+  Cache *tlb[3] = {sys->itlb[core_id], sys->dtlb[core_id], sys->l2tlb[core_id]};
+  const char *name[3] = {"ITLB", "DTLB", "L2TLB"};
+  uns64 walks = sys->stat_walks[core_id];
+  uns ii;
+
+  for(ii=0; ii<3; ii++){
+    uns64 access = tlb[ii]->stat_read_access;
+    printf("\n%s_%u_ACCESS    \t\t : %10llu", name[ii], core_id, access);
+    printf("\n%s_%u_MISS      \t\t : %10llu", name[ii], core_id, tlb[ii]->stat_read_miss);
+    printf("\n%s_%u_MISSPERC  \t\t : %10.3f", name[ii], core_id,
+           access ? 100.0*(double)tlb[ii]->stat_read_miss/(double)access : 0.0);
+  }
+  printf("\nWALK_%u_COUNT     \t\t : %10llu", core_id, walks);
+  printf("\nWALK_%u_PTE_LOADS \t\t : %10llu", core_id, sys->stat_walk_pte_loads[core_id]);
+  printf("\nWALK_%u_CYCLES    \t\t : %10llu", core_id, sys->stat_walk_cycles[core_id]);
+  printf("\nWALK_%u_AVG_CYCLES\t\t : %10.3f", core_id,
+         walks ? (double)sys->stat_walk_cycles[core_id]/(double)walks : 0.0);
+  printf("\nTLB_%u_DELAY      \t\t : %10llu", core_id, sys->stat_tlb_delay[core_id]);
+  printf("\n");
+}
+
 
 /////////////////////////////////////////////////////////////////////
 // This function is called on ICACHE miss, DCACHE miss, DCACHE writeback
@@ -354,19 +735,45 @@ uns64   memsys_L2_access(Memsys *sys, Addr lineaddr, Flag is_writeback, uns core
 
   uns64 delay = 0;
 
-  Flag outcome=cache_access(sys->l2cache, lineaddr, is_writeback, core_id);
-  if (outcome == MISS) {
-    delay = L2CACHE_HIT_LATENCY + dram_access(sys->dram, lineaddr, FALSE);
-    cache_install(sys->l2cache, lineaddr, is_writeback, core_id);
+  if(sys->par_log && !sys->par_replaying){
+    return memsys_L2_defer(sys, lineaddr, is_writeback, core_id);
+  }
+
+  if(sys->mrc_all){
+    mrc_access(sys->mrc_all, lineaddr);
+    if(sys->mrc_core[core_id]){
+      mrc_access(sys->mrc_core[core_id], lineaddr);
+    }
+  }
 
-    if (sys->l2cache->last_evicted_line.dirty) {
-      uns64 victim_lineaddr = (sys->l2cache->last_evicted_line.tag * sys->l2cache->num_sets) | 
-                              (lineaddr % sys->l2cache->num_sets);
-      dram_access(sys->dram, victim_lineaddr, TRUE);
+  Cache *l2 = sys->l2cache;
+  Flag outcome=cache_access(l2, lineaddr, is_writeback, core_id);
+  if (outcome == MISS) {
+    if (l2->mshr && !is_writeback) {
+      delay = cache_mshr_alloc(l2);
+    }
+    delay += L2CACHE_HIT_LATENCY;
+    cycle += delay;  // the miss reaches DRAM after the L2 lookup
+    uns64 dram_delay = dram_access(sys->dram, lineaddr, FALSE, core_id);
+    cycle -= delay;
+    delay += dram_delay;
+    cache_install(l2, lineaddr, is_writeback, core_id);
+    if (l2->last_evicted_line.dirty) {
+      delay += memsys_writeback(sys, l2, cycle + delay);
+    }
+    if (l2->mshr && !is_writeback) {
+      cache_mshr_fill(l2, lineaddr, cycle + delay);
     }
   } 
   else {
     delay = L2CACHE_HIT_LATENCY;
+    if (l2->mshr && !is_writeback) {
+      delay = cache_mshr_merge(l2, lineaddr, delay);
+    }
+  }
+
+  if (l2->pf && !is_writeback) {
+    delay = memsys_prefetch(sys, l2, lineaddr, outcome, delay, core_id);
   }
 
   //To get the delay of L2 MISS, you must use the dram_access() function
@@ -376,3 +783,198 @@ uns64   memsys_L2_access(Memsys *sys, Addr lineaddr, Flag is_writeback, uns core
   return delay;
 }
 
+
+/////////////////////////////////////////////////////////////////////
+// Writes back the dirty line c just evicted, to the L2 for an L1 and to
+// DRAM for the L2. Without a write-back buffer this happens right away.
+// With one, the victim leaves c when the fill that evicted it arrives,
+// merges with a queued writeback of the same line or takes an entry.
+// Queued writebacks overlap: each starts one transfer after the one
+// ahead of it (a DRAM bus burst for the L2, a cycle for an L1), and an
+// L2 writeback without -dramctl also waits for queued writes to its
+// bank. An entry stays busy for at least an L2 access (L1) or a cycle
+// (L2). The write itself is issued now, so that cache and row state
+// stay in order; start only times the entry. Returns the cycles that
+// fill waited for a free entry.
+/////////////////////////////////////////////////////////////////////
+
+// last done cycle of the writes queued in c for the bank of lineaddr
+static uns64 memsys_wbb_bank_free(Cache *c, Addr lineaddr){
+  uns64 bank = dram_bank_of(lineaddr), free = 0;
+  uns ii;
+  for(ii=0; ii<c->num_wbb; ii++){
+    if(c->wbb[ii].done_cycle > free && dram_bank_of(c->wbb[ii].lineaddr) == bank){
+      free = c->wbb[ii].done_cycle;
+    }
+  }
+  return free;
+}
+
+static uns64 memsys_writeback_issue(Memsys *sys, Cache *c, Addr lineaddr, uns core_id){
+  if(c == sys->l2cache){
+    return dram_access(sys->dram, lineaddr, TRUE, core_id);
+  }
+  return memsys_L2_access(sys, lineaddr, TRUE, core_id);
+}
+
+static uns64 memsys_writeback(Memsys *sys, Cache *c, uns64 when){
+  Addr  lineaddr = c->last_evicted_lineaddr;
+  uns   core_id  = c->last_evicted_line.core_id;
+  uns64 min_service = (c == sys->l2cache) ? 1 : L2CACHE_HIT_LATENCY;
+  uns64 gap = (c == sys->l2cache) ? dram_bus_cycles() : 1;
+  uns64 wait, start, service;
+
+  if(!c->wbb){
+    memsys_writeback_issue(sys, c, lineaddr, core_id);
+    return 0;
+  }
+  if(cache_wbb_coalesce(c, lineaddr, when)){
+    return 0;
+  }
+
+  wait  = cache_wbb_alloc(c, when);
+  start = when + wait;
+  if(c->wbb_drain_free > start){
+    start = c->wbb_drain_free;
+  }
+  if(c == sys->l2cache && !DRAM_CTL){
+    uns64 bank_free = memsys_wbb_bank_free(c, lineaddr);
+    start = (bank_free > start) ? bank_free : start;
+  }
+  c->wbb_drain_free = start + gap;
+  service = memsys_writeback_issue(sys, c, lineaddr, core_id);
+  cache_wbb_fill(c, lineaddr, start + (service > min_service ? service : min_service));
+  return wait;
+}
+
+/////////////////////////////////////////////////////////////////////
+// Prefetching, after each demand access to a cache with c->pf: account
+// for prefetched lines being used or evicted, train, and fill the
+// candidates (same 4KB page, not already cached) from the next level,
+// the L2 for an L1 and DRAM for the L2.
+/////////////////////////////////////////////////////////////////////
+
+static void memsys_prefetch_evict(Memsys *sys, Cache *c, Flag by_prefetch, uns64 when){
+  Cache_Line *victim = &c->last_evicted_line;
+  if(!victim->valid){
+    return;
+  }
+  prefetcher_evict(c->pf, c->last_evicted_lineaddr, victim->prefetched, by_prefetch);
+  if(by_prefetch && victim->dirty){
+    memsys_writeback(sys, c, when);
+  }
+}
+
+static uns64 memsys_prefetch(Memsys *sys, Cache *c, Addr lineaddr, Flag outcome, uns64 delay, uns core_id){
+  Prefetcher *pf = c->pf;
+  Addr  cand[PF_MAX_DEGREE];
+  Addr  page = lineaddr / (PAGE_SIZE/CACHE_LINESIZE);
+  Flag  pf_hit = (outcome==HIT) && c->last_hit_prefetched;
+  uns   ii, num;
+
+  if(pf_hit){
+    delay = prefetcher_demand_hit(pf, lineaddr, delay);
+  }
+  if(outcome==MISS){
+    prefetcher_demand_miss(pf, lineaddr);
+    memsys_prefetch_evict(sys, c, FALSE, cycle);
+  }
+
+  num = prefetcher_train(pf, sys->inst_pc[core_id], lineaddr, outcome==MISS, pf_hit, cand);
+  for(ii=0; ii<num; ii++){
+    uns64 fill_delay;
+    if(cand[ii] / (PAGE_SIZE/CACHE_LINESIZE) != page){
+      continue;
+    }
+    if(cache_probe(c, cand[ii], core_id)==HIT){
+      pf->stat_redundant++;
+      continue;
+    }
+
+    if(c == sys->l2cache){
+      fill_delay = L2CACHE_HIT_LATENCY + dram_access(sys->dram, cand[ii], FALSE, core_id);
+    }
+    else{
+      fill_delay = memsys_L2_access(sys, cand[ii], FALSE, core_id);
+    }
+    cache_install(c, cand[ii], FALSE, core_id);
+    cache_mark_prefetched(c);
+    prefetcher_fill(pf, cand[ii], cycle + fill_delay);
+    memsys_prefetch_evict(sys, c, TRUE, cycle + fill_delay);
+  }
+
+  return delay;
+}
+
+/////////////////////////////////////////////////////////////////////
+// -parallel: each core thread times its L2 accesses against the L2 and
+// DRAM state as of the start of the quantum (read only) and logs them.
+// At the barrier the logs are applied in (cycle, core_id) order, the
+// order the sequential loop would have used, and every demand access
+// whose real delay differs from the one charged counts as a mismatch.
+/////////////////////////////////////////////////////////////////////
+
+void memsys_par_enable(Memsys *sys){
+  sys->par_log = (Memsys_L2_Log *) calloc (MAX_CORES, sizeof(Memsys_L2_Log));
+}
+
+static uns64 memsys_L2_defer(Memsys *sys, Addr lineaddr, Flag is_writeback, uns core_id){
+  Memsys_L2_Log *log = &sys->par_log[core_id];
+  uns64 delay = 0;
+
+  if(!is_writeback){
+    delay = L2CACHE_HIT_LATENCY;
+    if(cache_probe(sys->l2cache, lineaddr, core_id) == MISS){
+      delay += dram_peek_delay(sys->dram, lineaddr, log->rows);
+    }
+  }
+
+  if(log->num_req == log->max_req){
+    log->max_req = log->max_req ? 2*log->max_req : 1024;
+    log->req = (Memsys_L2_Req *) realloc (log->req, log->max_req*sizeof(Memsys_L2_Req));
+  }
+  Memsys_L2_Req *r = &log->req[log->num_req++];
+  r->cycle        = cycle;
+  r->lineaddr     = lineaddr;
+  r->delay        = delay;
+  r->is_writeback = is_writeback;
+
+  return delay;
+}
+
+void memsys_par_replay(Memsys *sys){
+  uns64 pos[MAX_CORES] = {0};
+  uns   ii;
+
+  sys->par_replaying = TRUE;
+  while(1){
+    int next = -1;
+    for(ii=0; ii<NUM_CORES; ii++){
+      Memsys_L2_Log *log = &sys->par_log[ii];
+      if(pos[ii] < log->num_req &&
+         (next < 0 || log->req[pos[ii]].cycle < sys->par_log[next].req[pos[next]].cycle)){
+        next = ii;
+      }
+    }
+    if(next < 0){
+      break;
+    }
+
+    Memsys_L2_Req *r = &sys->par_log[next].req[pos[next]++];
+    cycle = r->cycle;
+    uns64 delay = memsys_L2_access(sys, r->lineaddr, r->is_writeback, next);
+    if(!r->is_writeback){
+      sys->stat_par_l2_reads++;
+      if(delay != r->delay){
+        sys->stat_par_l2_mismatch++;
+        sys->stat_par_l2_delay_err += (delay > r->delay) ? delay - r->delay : r->delay - delay;
+      }
+    }
+  }
+  sys->par_replaying = FALSE;
+
+  for(ii=0; ii<NUM_CORES; ii++){
+    sys->par_log[ii].num_req = 0;
+    memset(sys->par_log[ii].rows, 0, sizeof(sys->par_log[ii].rows));
+  }
+}
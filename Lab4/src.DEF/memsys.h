@@ -4,12 +4,31 @@
 #include "types.h"
 #include "cache.h"
 #include "dram.h"
+#include "prefetch.h"
+#include "mrc.h"
+#include "pagealloc.h"
+#include "directory.h"
 
 //////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////
 
 typedef struct Memsys   Memsys;
 
+// -parallel: an L2 access made during a quantum, applied at the barrier
+typedef struct Memsys_L2_Req {
+  uns64 cycle;
+  Addr  lineaddr;
+  uns64 delay;         // latency the core was charged (0 for writebacks)
+  Flag  is_writeback;
+} Memsys_L2_Req;
+
+typedef struct Memsys_L2_Log {
+  Memsys_L2_Req *req;
+  uns64 num_req;
+  uns64 max_req;
+  Rowbuf_Entry rows[MAX_DRAM_BANKS]; // rows this core opened this quantum
+} Memsys_L2_Log;
+
 struct Memsys {
   // want to delete these for christ sakes
   Cache *dcache;  // For Part A
@@ -21,13 +40,37 @@ struct Memsys {
   Cache *l2cache; // For Part A,B,C,D,E
   DRAM  *dram;    // For Part C,D,E
 
-   // stats 
-  uns64 stat_ifetch_access;
-  uns64 stat_load_access;
-  uns64 stat_store_access;
-  uns64 stat_ifetch_delay;
-  uns64 stat_load_delay;
-  uns64 stat_store_delay;
+  uns   pfn_head_shift; // VPN bits above the core_id field, see vpn_to_pfn
+  Page_Alloc *page_alloc; // -pagealloc: frames from a page table, NULL: vpn_to_pfn
+  Directory  *dir;        // -shared: L1 data cache sharers per line
+
+  Cache *itlb[MAX_CORES];   // -tlb (Part D,E,F): L1 TLBs and L2 TLB per core,
+  Cache *dtlb[MAX_CORES];   // keyed by virtual page
+  Cache *l2tlb[MAX_CORES];
+
+  Addr  inst_pc[MAX_CORES]; // PC of each core's current inst, for prefetchers
+
+  Mrc  *mrc_all;               // -mrc: L2 stack distances of all cores
+  Mrc  *mrc_core[MAX_CORES];   // ... and of each core alone (modes D-F)
+
+  Memsys_L2_Log *par_log; // per-core deferred L2 accesses, -parallel only
+  Flag  par_replaying;
+
+   // stats (per core, so parallel core threads do not share counters)
+  uns64 stat_ifetch_access[MAX_CORES];
+  uns64 stat_load_access[MAX_CORES];
+  uns64 stat_store_access[MAX_CORES];
+  uns64 stat_ifetch_delay[MAX_CORES];
+  uns64 stat_load_delay[MAX_CORES];
+  uns64 stat_store_delay[MAX_CORES];
+  uns64 stat_tlb_delay[MAX_CORES];      // cycles added by L1 TLB misses
+  uns64 stat_walks[MAX_CORES];          // L2 TLB misses
+  uns64 stat_walk_pte_loads[MAX_CORES];
+  uns64 stat_walk_cycles[MAX_CORES];
+
+  uns64 stat_par_l2_reads;       // demand L2 accesses replayed
+  uns64 stat_par_l2_mismatch;    // ... whose replayed delay differed
+  uns64 stat_par_l2_delay_err;   // sum of |replayed - charged| delay
 };
 
 
@@ -47,6 +90,11 @@ uns64   memsys_access_modeDEF(Memsys *sys, Addr lineaddr, Access_Type type, uns
 // For mode B/C/D/E you must use this function to access L2 
 uns64   memsys_L2_access(Memsys *sys, Addr lineaddr, Flag is_writeback, uns core_id);
 
+// -parallel: defer L2 accesses to per-core logs, replay them in
+// (cycle, core_id) order at the end of each quantum
+void    memsys_par_enable(Memsys *sys);
+void    memsys_par_replay(Memsys *sys);
+
 // This function can convert VPN to PFN
 uns64 memsys_convert_vpn_to_pfn(Memsys *sys, uns64 vpn, uns core_id);
 
@@ -0,0 +1,243 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mrc.h"
+
+#define MRC_NO_LINE      (~0U)
+#define MRC_TREE_CAP_MIN 1024
+
+static uns mrc_line_index(Mrc *m, Addr lineaddr);
+
+
+////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////
+
+Mrc    *mrc_new(void){
+  Mrc *m = (Mrc *) calloc (1, sizeof (Mrc));
+  uns s;
+
+  m->max_lines = 1024;
+  m->lines     = (Mrc_Line *) calloc (m->max_lines, sizeof(Mrc_Line));
+  m->hash_size = 2*m->max_lines;
+  m->hash      = (uns *) calloc (m->hash_size, sizeof(uns));
+  for(s=1; s<MRC_NUM_S; s++){
+    m->stack[s] = (uns *) calloc ((1U << s)*MRC_MAX_WAYS, sizeof(uns));
+  }
+  return m;
+}
+
+////////////////////////////////////////////////////////////////////
+// Fenwick tree helpers, 1-based
+////////////////////////////////////////////////////////////////////
+
+static void fenwick_add(uns *bit, uns cap, uns pos, int val){
+  for(; pos <= cap; pos += pos & -pos){
+    bit[pos] += val;
+  }
+}
+
+static uns fenwick_prefix(uns *bit, uns pos){
+  uns sum = 0;
+  for(; pos; pos -= pos & -pos){
+    sum += bit[pos];
+  }
+  return sum;
+}
+
+// Out of times: renumber the live lines 1..live if that frees at least
+// half the tree, else double it. When doubling, every new node except
+// the top one covers only empty times; the top one covers all of them.
+static void mrc_make_room(Mrc *m, uns live){
+  uns ii, pos = 0;
+
+  if(m->cap == 0){
+    m->cap = MRC_TREE_CAP_MIN;
+    m->bit = (uns *) calloc (m->cap+1, sizeof(uns));
+    m->who = (uns *) malloc ((m->cap+1)*sizeof(uns));
+    for(ii=0; ii<=m->cap; ii++){
+      m->who[ii] = MRC_NO_LINE;
+    }
+    return;
+  }
+
+  if(2*live <= m->cap){
+    for(ii=1; ii<=m->time; ii++){
+      if(m->who[ii] != MRC_NO_LINE){
+        m->who[++pos] = m->who[ii];
+        m->lines[m->who[pos]].last = pos;
+      }
+    }
+    for(ii=pos+1; ii<=m->cap; ii++){
+      m->who[ii] = MRC_NO_LINE;
+    }
+    // linear-time rebuild
+    memset(m->bit, 0, (m->cap+1)*sizeof(uns));
+    for(ii=1; ii<=m->cap; ii++){
+      uns up = ii + (ii & -ii);
+      m->bit[ii] += (ii <= pos);
+      if(up <= m->cap){
+        m->bit[up] += m->bit[ii];
+      }
+    }
+    m->time = pos;
+    return;
+  }
+
+  uns old_cap = m->cap;
+  m->cap *= 2;
+  m->bit = (uns *) realloc (m->bit, (m->cap+1)*sizeof(uns));
+  m->who = (uns *) realloc (m->who, (m->cap+1)*sizeof(uns));
+  for(ii=old_cap+1; ii<=m->cap; ii++){
+    m->bit[ii] = 0;
+    m->who[ii] = MRC_NO_LINE;
+  }
+  m->bit[m->cap] = live;
+}
+
+static uns mrc_bucket(uns64 dist){
+  uns b = 0;
+  while(dist){
+    b++;
+    dist >>= 1;
+  }
+  return b;
+}
+
+////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////
+
+void    mrc_access(Mrc *m, Addr lineaddr){
+  uns idx = mrc_line_index(m, lineaddr);
+  uns prev = m->lines[idx].last;
+  uns bound = MRC_MAX_WAYS;   // the line is at most this deep in the stacks
+  uns s;
+
+  m->stat_access++;
+
+  // one set: exact distance from the tree
+  if(prev){
+    uns dist = m->num_lines - fenwick_prefix(m->bit, prev);
+    m->hist[0][mrc_bucket(dist)]++;
+    fenwick_add(m->bit, m->cap, prev, -1);
+    m->who[prev] = MRC_NO_LINE;
+    if(dist < MRC_MAX_WAYS){
+      bound = dist+1;
+    }
+  }
+  else{
+    m->hist[0][MRC_COLD]++;
+  }
+  if(m->time == m->cap){
+    mrc_make_room(m, m->num_lines-1);
+  }
+  m->time++;
+  fenwick_add(m->bit, m->cap, m->time, 1);
+  m->who[m->time] = idx;
+  m->lines[idx].last = m->time;
+
+  // more sets: truncated move-to-front stacks
+  for(s=1; s<MRC_NUM_S; s++){
+    uns *stack = &m->stack[s][(lineaddr & ((1U << s)-1))*MRC_MAX_WAYS];
+    uns key = idx+1;
+    uns pos = MRC_MAX_WAYS;
+
+    if(prev){
+      for(pos=0; pos<bound && stack[pos] != key; pos++);
+      if(pos == bound){
+        assert(bound == MRC_MAX_WAYS);
+        pos = MRC_MAX_WAYS;
+      }
+    }
+
+    if(pos < MRC_MAX_WAYS){
+      m->hist[s][mrc_bucket(pos)]++;
+      bound = pos+1;
+    }
+    else{
+      m->hist[s][MRC_COLD]++;
+      pos = MRC_MAX_WAYS-1;   // the LRU entry falls off
+    }
+    memmove(stack+1, stack, pos*sizeof(uns));
+    stack[0] = key;
+  }
+}
+
+////////////////////////////////////////////////////////////////////
+// Line table: lineaddr -> index into m->lines
+////////////////////////////////////////////////////////////////////
+
+static uns mrc_hash_slot(Mrc *m, Addr lineaddr){
+  uns slot = (uns)((lineaddr * 0x9E3779B97F4A7C15ULL) >> 32) & (m->hash_size-1);
+  while(m->hash[slot] && m->lines[m->hash[slot]-1].lineaddr != lineaddr){
+    slot = (slot+1) & (m->hash_size-1);
+  }
+  return slot;
+}
+
+static uns mrc_line_index(Mrc *m, Addr lineaddr){
+  uns slot = mrc_hash_slot(m, lineaddr);
+  uns ii;
+
+  if(m->hash[slot]){
+    return m->hash[slot]-1;
+  }
+
+  if(m->num_lines == m->max_lines){
+    m->max_lines *= 2;
+    m->lines = (Mrc_Line *) realloc (m->lines, m->max_lines*sizeof(Mrc_Line));
+    m->hash_size *= 2;
+    free(m->hash);
+    m->hash = (uns *) calloc (m->hash_size, sizeof(uns));
+    for(ii=0; ii<m->num_lines; ii++){
+      m->hash[mrc_hash_slot(m, m->lines[ii].lineaddr)] = ii+1;
+    }
+    slot = mrc_hash_slot(m, lineaddr);
+  }
+
+  memset(&m->lines[m->num_lines], 0, sizeof(Mrc_Line));
+  m->lines[m->num_lines].lineaddr = lineaddr;
+  m->hash[slot] = ++m->num_lines;
+  return m->num_lines-1;
+}
+
+////////////////////////////////////////////////////////////////////
+// Miss ratio of every set count x power-of-two ways, then the fully
+// associative curve (one set) by capacity until only cold misses remain.
+////////////////////////////////////////////////////////////////////
+
+void    mrc_print_stats(Mrc *m, char *header, uns64 linesize){
+  uns64 total = m->stat_access;
+  uns s, b, ways;
+
+  printf("\n%s_ACCESS         \t\t : %10llu", header, total);
+  printf("\n%s_COLD_MISS      \t\t : %10llu", header, m->hist[0][MRC_COLD]);
+  if(!total){
+    printf("\n");
+    return;
+  }
+
+  printf("\n%s_MISSPERC_WAYS  \t\t :", header);
+  for(ways=1; ways<=MRC_MAX_WAYS; ways*=2){
+    printf(" %7u", ways);
+  }
+  for(s=0; s<MRC_NUM_S; s++){
+    uns64 hits = 0;
+    printf("\n%s_SETS_%-6u    \t\t :", header, 1U << s);
+    for(b=0, ways=1; ways<=MRC_MAX_WAYS; b++, ways*=2){
+      hits += m->hist[s][b];
+      printf(" %7.3f", 100.0*(double)(total-hits)/(double)total);
+    }
+  }
+
+  uns64 hits = 0;
+  for(b=0; b<MRC_COLD && hits < total - m->hist[0][MRC_COLD]; b++){
+    hits += m->hist[0][b];
+    if(((1ULL << b)*linesize) >= 1024){
+      printf("\n%s_FA_%-8lluKB  \t\t : %10.3f", header,
+             ((1ULL << b)*linesize) >> 10, 100.0*(double)(total-hits)/(double)total);
+    }
+  }
+  printf("\n");
+}
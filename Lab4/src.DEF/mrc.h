@@ -0,0 +1,62 @@
+#ifndef MRC_H
+#define MRC_H
+
+#include "types.h"
+
+#define MRC_SET_BITS     14   // set counts 1, 2, 4 .. 16384
+#define MRC_NUM_S        (MRC_SET_BITS+1)
+#define MRC_MAX_WAYS     64   // depth of the per-set stacks, widest column printed
+#define MRC_BUCKETS      34   // 0: distance 0, b: [2^(b-1), 2^b), last: cold/deeper
+#define MRC_COLD         (MRC_BUCKETS-1)
+
+//////////////////////////////////////////////////////////////////
+// Single-pass LRU stack distances (Mattson) for every power-of-two
+// set count at once. The distance of an access within its set is the
+// number of distinct lines of that set touched since the same line was
+// last touched; a cache with that many sets and A ways hits iff the
+// distance is below A.
+//
+// With one set (fully associative) distances are unbounded: an
+// order-statistics (Fenwick) tree over access times holds a 1 at each
+// line's last access, and the distance is a suffix count. With more
+// sets only distances below MRC_MAX_WAYS matter, so each set keeps a
+// move-to-front stack that deep. Doubling the sets splits each set in
+// two, so a line's distance can only shrink (set refinement); the scan
+// at each set count stops at the distance found at the previous one.
+//////////////////////////////////////////////////////////////////
+
+typedef struct Mrc Mrc;
+
+typedef struct Mrc_Line {
+  Addr  lineaddr;
+  uns   last;       // time of the last access, 0: none
+} Mrc_Line;
+
+struct Mrc {
+  Mrc_Line *lines;
+  uns   num_lines;
+  uns   max_lines;
+  uns  *hash;       // open addressing, line index + 1, 0 is empty
+  uns   hash_size;  // power of two, kept at least twice num_lines
+
+  // one set: Fenwick tree over times 1..cap and the line at each time
+  uns  *bit;
+  uns  *who;
+  uns   cap;        // power of two, compacted or doubled when full
+  uns   time;       // last time handed out
+
+  // 2^s sets for s >= 1: MRC_MAX_WAYS line indices+1 per set, MRU first
+  uns  *stack[MRC_NUM_S];
+
+  uns64 stat_access;
+  uns64 hist[MRC_NUM_S][MRC_BUCKETS];
+};
+
+//////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////
+
+Mrc    *mrc_new(void);
+void    mrc_access(Mrc *m, Addr lineaddr);
+void    mrc_print_stats(Mrc *m, char *header, uns64 linesize);
+
+#endif // MRC_H
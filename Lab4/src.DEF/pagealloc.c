@@ -0,0 +1,202 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pagealloc.h"
+
+extern void die_message(const char * msg);
+
+#define PAGE_ALLOC_COLOR_SCAN  4096  // frames looked at to find the bank colors
+
+
+////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////
+
+static void page_table_init(Page_Table *pt){
+  pt->size = 1024;
+  pt->num  = 0;
+  pt->vpn  = (uns64 *) calloc (pt->size, sizeof(uns64));
+  pt->pfn  = (uns64 *) calloc (pt->size, sizeof(uns64));
+}
+
+static uns64 page_table_slot(Page_Table *pt, uns64 vpn){
+  uns64 slot = ((vpn * 0x9E3779B97F4A7C15ULL) >> 32) & (pt->size-1);
+  while(pt->vpn[slot] && pt->vpn[slot] != vpn+1){
+    slot = (slot+1) & (pt->size-1);
+  }
+  return slot;
+}
+
+static void page_table_grow(Page_Table *pt){
+  uns64 *old_vpn = pt->vpn, *old_pfn = pt->pfn;
+  uns64 old_size = pt->size, ii;
+
+  pt->size *= 2;
+  pt->vpn = (uns64 *) calloc (pt->size, sizeof(uns64));
+  pt->pfn = (uns64 *) calloc (pt->size, sizeof(uns64));
+  for(ii=0; ii<old_size; ii++){
+    if(old_vpn[ii]){
+      uns64 slot = page_table_slot(pt, old_vpn[ii]-1);
+      pt->vpn[slot] = old_vpn[ii];
+      pt->pfn[slot] = old_pfn[ii];
+    }
+  }
+  free(old_vpn);
+  free(old_pfn);
+}
+
+////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////
+
+Page_Alloc *page_alloc_new(uns policy, uns num_cores, uns64 lines_per_page, uns l2_colors){
+  Page_Alloc *pa = (Page_Alloc *) calloc (1, sizeof (Page_Alloc));
+  uns ii;
+
+  pa->policy = policy;
+  pa->num_cores = num_cores;
+  pa->lines_per_page = lines_per_page;
+  for(ii=0; ii<num_cores; ii++){
+    page_table_init(&pa->pt[ii]);
+  }
+
+  if(policy == PAGE_ALLOC_RANDOM){
+    pa->rng  = 0x2545F4914F6CDD1DULL;
+    pa->used = (uns8 *) calloc (PAGE_ALLOC_FRAMES, sizeof(uns8));
+  }
+
+  if(policy == PAGE_ALLOC_L2COLOR){
+    pa->num_colors = l2_colors ? l2_colors : 1;
+    if(pa->num_colors > PAGE_ALLOC_MAX_COLORS){
+      pa->num_colors = PAGE_ALLOC_MAX_COLORS;
+    }
+  }
+
+  // the banks that first lines of frames map to, numbered as found
+  if(policy == PAGE_ALLOC_BANKCOLOR){
+    uns64 frame;
+    for(ii=0; ii<MAX_DRAM_BANKS; ii++){
+      pa->bank_color[ii] = PAGE_ALLOC_MAX_COLORS;
+    }
+    for(frame=0; frame<PAGE_ALLOC_COLOR_SCAN; frame++){
+      uns64 bank = dram_bank_of(frame*lines_per_page);
+      if(pa->bank_color[bank] == PAGE_ALLOC_MAX_COLORS){
+        pa->bank_color[bank] = pa->num_colors++;
+      }
+    }
+  }
+
+  for(ii=0; ii<num_cores && pa->num_colors; ii++){
+    if(num_cores <= pa->num_colors){
+      pa->core_color_first[ii] = ii*pa->num_colors/num_cores;
+      pa->core_color_num[ii]   = (ii+1)*pa->num_colors/num_cores - pa->core_color_first[ii];
+    }
+    else{
+      pa->core_color_first[ii] = ii % pa->num_colors;
+      pa->core_color_num[ii]   = 1;
+    }
+  }
+  return pa;
+}
+
+////////////////////////////////////////////////////////////////////
+// Frame allocation, one function per policy
+////////////////////////////////////////////////////////////////////
+
+static uns page_alloc_frame_color(Page_Alloc *pa, uns64 frame){
+  if(pa->policy == PAGE_ALLOC_L2COLOR){
+    return frame % pa->num_colors;
+  }
+  // PAGE_ALLOC_MAX_COLORS for banks the scan never saw
+  return pa->bank_color[dram_bank_of(frame*pa->lines_per_page)];
+}
+
+// Every frame has one color, so each color's cursor can hand out the
+// frames of its color in order without checking the others
+static uns64 page_alloc_colored(Page_Alloc *pa, uns64 vpn, uns core_id){
+  uns color = pa->core_color_first[core_id] + vpn % pa->core_color_num[core_id];
+  uns64 *cursor = &pa->color_cursor[color];
+
+  while(*cursor < PAGE_ALLOC_FRAMES && page_alloc_frame_color(pa, *cursor) != color){
+    (*cursor)++;
+    pa->stat_frames_skipped++;
+  }
+  if(*cursor == PAGE_ALLOC_FRAMES){
+    die_message("-pagealloc ran out of frames of one color");
+  }
+  return (*cursor)++;
+}
+
+static uns64 page_alloc_random(Page_Alloc *pa){
+  uns64 frame;
+
+  if(pa->num_used == PAGE_ALLOC_FRAMES){
+    die_message("-pagealloc ran out of frames");
+  }
+  do{
+    pa->rng ^= pa->rng << 13;
+    pa->rng ^= pa->rng >> 7;
+    pa->rng ^= pa->rng << 17;
+    frame = pa->rng % PAGE_ALLOC_FRAMES;
+  }while(pa->used[frame]);
+  pa->used[frame] = 1;
+  pa->num_used++;
+  return frame;
+}
+
+static uns64 page_alloc_frame(Page_Alloc *pa, uns64 vpn, uns core_id){
+  switch(pa->policy){
+  case PAGE_ALLOC_SEQUENTIAL:
+    if(pa->next_frame == PAGE_ALLOC_FRAMES){
+      die_message("-pagealloc ran out of frames");
+    }
+    return pa->next_frame++;
+  case PAGE_ALLOC_RANDOM:
+    return page_alloc_random(pa);
+  default:
+    return page_alloc_colored(pa, vpn, core_id);
+  }
+}
+
+////////////////////////////////////////////////////////////////////
+// The frame of a core's page, allocated the first time it is touched
+////////////////////////////////////////////////////////////////////
+
+uns64   page_alloc_pfn(Page_Alloc *pa, uns64 vpn, uns core_id){
+  Page_Table *pt = &pa->pt[core_id];
+  uns64 slot = page_table_slot(pt, vpn);
+
+  if(pt->vpn[slot]){
+    return pt->pfn[slot];
+  }
+
+  if(2*(pt->num+1) > pt->size){
+    page_table_grow(pt);
+    slot = page_table_slot(pt, vpn);
+  }
+  pt->vpn[slot] = vpn+1;
+  pt->pfn[slot] = page_alloc_frame(pa, vpn, core_id);
+  pt->num++;
+  if(pt->pfn[slot] > pa->stat_max_frame){
+    pa->stat_max_frame = pt->pfn[slot];
+  }
+  return pt->pfn[slot];
+}
+
+////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////
+
+void    page_alloc_print_stats(Page_Alloc *pa){
+  uns ii;
+
+  printf("\nPAGEALLOC_POLICY       \t\t : %10u", pa->policy);
+  for(ii=0; ii<pa->num_cores; ii++){
+    printf("\nPAGEALLOC_PAGES_CORE%u  \t\t : %10llu", ii, pa->pt[ii].num);
+  }
+  printf("\nPAGEALLOC_MAX_FRAME    \t\t : %10llu", pa->stat_max_frame);
+  if(pa->num_colors){
+    printf("\nPAGEALLOC_COLORS       \t\t : %10u", pa->num_colors);
+    printf("\nPAGEALLOC_FRAMES_SKIPPED\t\t : %10llu", pa->stat_frames_skipped);
+  }
+  printf("\n");
+}
@@ -0,0 +1,61 @@
+#ifndef PAGEALLOC_H
+#define PAGEALLOC_H
+
+#include "types.h"
+#include "dram.h"
+
+#define PAGE_ALLOC_FIXED       0  // memsys_convert_vpn_to_pfn, no page table
+#define PAGE_ALLOC_SEQUENTIAL  1  // next free frame, in first-touch order over all cores
+#define PAGE_ALLOC_RANDOM      2  // a uniformly random free frame
+#define PAGE_ALLOC_L2COLOR     3  // each core gets its own share of the L2 set colors
+#define PAGE_ALLOC_BANKCOLOR   4  // each core gets its own share of the DRAM banks
+
+#define PAGE_ALLOC_FRAMES      (1ULL << 20)  // 4GB of 4KB frames
+#define PAGE_ALLOC_MAX_COLORS  256
+
+//////////////////////////////////////////////////////////////////
+// Physical frames for the pages the cores touch, allocated on first
+// touch and kept in a page table per core. A color is the L2 sets a
+// frame maps to (frame mod L2 size/4KB per way) or the DRAM bank its
+// first line maps to. Under the coloring policies a core's page goes
+// to one of the core's colors, picked by the low VPN bits so that
+// neighboring pages spread over them; when there are more cores than
+// colors, cores share one color each.
+//////////////////////////////////////////////////////////////////
+
+typedef struct Page_Table {
+  uns64 *vpn;       // open addressing, vpn+1, 0 is empty
+  uns64 *pfn;
+  uns64  size;      // power of two, kept at least twice num
+  uns64  num;
+} Page_Table;
+
+typedef struct Page_Alloc {
+  uns    policy;
+  uns    num_cores;
+  uns64  lines_per_page;
+  Page_Table pt[MAX_CORES];
+
+  uns64  next_frame;    // SEQUENTIAL
+  uns64  rng;           // RANDOM: xorshift64 state
+  uns8  *used;          // RANDOM: per frame
+  uns64  num_used;
+
+  uns    num_colors;    // *COLOR
+  uns    bank_color[MAX_DRAM_BANKS]; // BANKCOLOR: color of each bank index
+  uns64  color_cursor[PAGE_ALLOC_MAX_COLORS]; // lowest frame not yet looked at
+  uns    core_color_first[MAX_CORES];
+  uns    core_color_num[MAX_CORES];
+
+  uns64  stat_max_frame;
+  uns64  stat_frames_skipped; // looked at by a color cursor, other color
+} Page_Alloc;
+
+//////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////
+
+Page_Alloc *page_alloc_new(uns policy, uns num_cores, uns64 lines_per_page, uns l2_colors);
+uns64   page_alloc_pfn(Page_Alloc *pa, uns64 vpn, uns core_id);
+void    page_alloc_print_stats(Page_Alloc *pa);
+
+#endif // PAGEALLOC_H
@@ -0,0 +1,272 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "prefetch.h"
+
+extern __thread uns64 cycle;
+
+// best-offset candidates: products of 2, 3 and 5 up to half a 4KB page
+static const int bo_offsets[PF_BO_OFFSETS] =
+  {1, 2, 3, 4, 5, 6, 8, 9, 10, 12, 15, 16, 18, 20, 24, 25, 27, 30, 32};
+
+#define BO_SCORE_MAX   31
+#define BO_ROUND_MAX   100
+#define BO_BAD_SCORE   1
+
+
+////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////
+
+Prefetcher *prefetcher_new(uns type, uns degree){
+  Prefetcher *pf = (Prefetcher *) calloc (1, sizeof (Prefetcher));
+  pf->type   = type;
+  pf->degree = degree;
+  if(pf->degree < 1){
+    pf->degree = 1;
+  }
+  if(pf->degree > PF_MAX_DEGREE){
+    pf->degree = PF_MAX_DEGREE;
+  }
+  pf->bo_offset = 1;
+  return pf;
+}
+
+////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////
+
+void    prefetcher_print_stats(Prefetcher *pf, char *header){
+  double accuracy=0, coverage=0, lateness=0;
+
+  if(pf->stat_issued){
+    accuracy = (double)pf->stat_useful/(double)pf->stat_issued;
+  }
+  if(pf->stat_useful + pf->stat_demand_miss){
+    coverage = (double)pf->stat_useful/(double)(pf->stat_useful + pf->stat_demand_miss);
+  }
+  if(pf->stat_useful){
+    lateness = (double)pf->stat_late/(double)pf->stat_useful;
+  }
+
+  printf("\n%s_PF_ISSUED      \t\t : %10llu", header, pf->stat_issued);
+  printf("\n%s_PF_REDUNDANT   \t\t : %10llu", header, pf->stat_redundant);
+  printf("\n%s_PF_USEFUL      \t\t : %10llu", header, pf->stat_useful);
+  printf("\n%s_PF_LATE        \t\t : %10llu", header, pf->stat_late);
+  printf("\n%s_PF_USELESS     \t\t : %10llu", header, pf->stat_useless);
+  printf("\n%s_PF_POLLUTION   \t\t : %10llu", header, pf->stat_pollution);
+  printf("\n%s_PF_ACCURACY    \t\t : %10.3f", header, 100*accuracy);
+  printf("\n%s_PF_COVERAGE    \t\t : %10.3f", header, 100*coverage);
+  printf("\n%s_PF_LATENESS    \t\t : %10.3f", header, 100*lateness);
+  if(pf->type == PF_BESTOFFSET){
+    printf("\n%s_PF_BO_OFFSET   \t\t : %10d", header, pf->bo_offset);
+    printf("\n%s_PF_BO_PHASES   \t\t : %10llu", header, pf->stat_bo_phases);
+  }
+  printf("\n");
+}
+
+////////////////////////////////////////////////////////////////////
+// Bookkeeping, called by memsys around the demand access
+////////////////////////////////////////////////////////////////////
+
+// A demand hit on a line still marked prefetched: its first use. If the
+// fill is still on its way the demand waits for it.
+uns64   prefetcher_demand_hit(Prefetcher *pf, Addr lineaddr, uns64 delay){
+  uns ii;
+  pf->stat_useful++;
+  for(ii=0; ii<PF_INFLIGHT; ii++){
+    if(pf->inflight_line[ii] == lineaddr && pf->inflight_ready[ii] > cycle + delay){
+      pf->stat_late++;
+      return pf->inflight_ready[ii] - cycle;
+    }
+  }
+  return delay;
+}
+
+void    prefetcher_demand_miss(Prefetcher *pf, Addr lineaddr){
+  Addr *v = &pf->victims[lineaddr % PF_VICTIMS];
+  pf->stat_demand_miss++;
+  if(*v == lineaddr+1){
+    pf->stat_pollution++;
+    *v = 0;
+  }
+}
+
+void    prefetcher_fill(Prefetcher *pf, Addr lineaddr, uns64 ready_cycle){
+  pf->stat_issued++;
+  pf->inflight_line[pf->inflight_next]  = lineaddr;
+  pf->inflight_ready[pf->inflight_next] = ready_cycle;
+  pf->inflight_next = (pf->inflight_next+1) % PF_INFLIGHT;
+}
+
+// A line left the cache. Lines pushed out by prefetch fills are
+// remembered so a later demand miss on them counts as pollution.
+void    prefetcher_evict(Prefetcher *pf, Addr victim, Flag unused_prefetch, Flag by_prefetch){
+  if(unused_prefetch){
+    pf->stat_useless++;
+  }
+  else if(by_prefetch){
+    pf->victims[victim % PF_VICTIMS] = victim+1;
+  }
+}
+
+////////////////////////////////////////////////////////////////////
+// Training. Returns the number of candidate lines written to cand,
+// memsys drops the ones already cached or outside the page.
+////////////////////////////////////////////////////////////////////
+
+static uns pf_stride(Prefetcher *pf, Addr pc, Addr lineaddr, Addr *cand){
+  Pf_Rpt_Entry *e = &pf->rpt[(pc ^ (pc >> 8)) % PF_RPT_SIZE];
+  uns num = 0, ii;
+
+  if(e->pc != pc){
+    e->pc        = pc;
+    e->last_line = lineaddr;
+    e->stride    = 0;
+    e->conf      = 0;
+    return 0;
+  }
+
+  int64 stride = (int64)(lineaddr - e->last_line);
+  if(stride == 0){
+    return 0;       // same line again, nothing learned
+  }
+  if(stride == e->stride){
+    if(e->conf < 3){
+      e->conf++;
+    }
+  }
+  else if(e->conf){
+    e->conf--;
+  }
+  else{
+    e->stride = stride;
+  }
+  e->last_line = lineaddr;
+
+  if(e->conf >= 2){
+    for(ii=1; ii<=pf->degree; ii++){
+      cand[num++] = lineaddr + ii*e->stride;
+    }
+  }
+  return num;
+}
+
+static uns pf_stream(Prefetcher *pf, Addr lineaddr, Flag miss, Addr *cand){
+  Pf_Stream *s = NULL;
+  uns num = 0, ii;
+
+  for(ii=0; ii<PF_STREAMS; ii++){
+    Pf_Stream *t = &pf->stream[ii];
+    int64 dist = (int64)(lineaddr - t->last_line);
+    if(t->valid && dist != 0 && dist >= -PF_STREAM_WINDOW && dist <= PF_STREAM_WINDOW){
+      s = t;
+      break;
+    }
+  }
+
+  if(!s){
+    if(!miss){
+      return 0;     // only misses start streams
+    }
+    s = &pf->stream[0];
+    for(ii=1; ii<PF_STREAMS; ii++){
+      if(!pf->stream[ii].valid || pf->stream[ii].last_use < s->last_use){
+        s = &pf->stream[ii];
+        if(!s->valid){
+          break;
+        }
+      }
+    }
+    s->valid     = TRUE;
+    s->last_line = lineaddr;
+    s->dir       = 1;
+    s->conf      = 0;
+    s->last_use  = ++pf->stream_clock;
+    return 0;
+  }
+
+  int dir = (lineaddr > s->last_line) ? 1 : -1;
+  if(dir == s->dir){
+    if(s->conf < 3){
+      s->conf++;
+    }
+  }
+  else{
+    s->dir  = dir;
+    s->conf = 0;
+  }
+  s->last_line = lineaddr;
+  s->last_use  = ++pf->stream_clock;
+
+  if(s->conf >= 2){
+    for(ii=1; ii<=pf->degree; ii++){
+      cand[num++] = lineaddr + (int64)ii*s->dir;
+    }
+  }
+  return num;
+}
+
+static uns pf_bestoffset(Prefetcher *pf, Addr lineaddr, Addr *cand){
+  uns ii, best = 0;
+
+  // learning: would offset bo_test have prefetched this line in time?
+  Addr base = lineaddr - bo_offsets[pf->bo_test];
+  if(pf->bo_rr[base % PF_BO_RR_SIZE] == base){
+    pf->bo_score[pf->bo_test]++;
+  }
+  Flag phase_end = (pf->bo_score[pf->bo_test] >= BO_SCORE_MAX);
+  if(++pf->bo_test == PF_BO_OFFSETS){
+    pf->bo_test = 0;
+    phase_end |= (++pf->bo_round >= BO_ROUND_MAX);
+  }
+
+  if(phase_end){
+    for(ii=1; ii<PF_BO_OFFSETS; ii++){
+      if(pf->bo_score[ii] > pf->bo_score[best]){
+        best = ii;
+      }
+    }
+    pf->bo_offset = (pf->bo_score[best] > BO_BAD_SCORE) ? bo_offsets[best] : 0;
+    memset(pf->bo_score, 0, sizeof(pf->bo_score));
+    pf->bo_test  = 0;
+    pf->bo_round = 0;
+    pf->stat_bo_phases++;
+  }
+
+  // recent requests: the trigger lines of past prefetches. The paper
+  // inserts them when the prefetch fill completes, here at issue time.
+  pf->bo_rr[lineaddr % PF_BO_RR_SIZE] = lineaddr;
+
+  if(pf->bo_offset == 0){
+    return 0;
+  }
+  for(ii=0; ii<pf->degree; ii++){
+    cand[ii] = lineaddr + (Addr)(ii+1)*pf->bo_offset;
+  }
+  return pf->degree;
+}
+
+// miss: the demand missed; pf_hit: it hit a line a prefetch brought in
+uns     prefetcher_train(Prefetcher *pf, Addr pc, Addr lineaddr, Flag miss, Flag pf_hit, Addr *cand){
+  uns ii;
+
+  switch(pf->type){
+  case PF_NEXTLINE:
+    if(!miss && !pf_hit){
+      return 0;
+    }
+    for(ii=0; ii<pf->degree; ii++){
+      cand[ii] = lineaddr + ii+1;
+    }
+    return pf->degree;
+  case PF_STRIDE:
+    return pf_stride(pf, pc, lineaddr, cand);
+  case PF_STREAM:
+    return (miss || pf_hit) ? pf_stream(pf, lineaddr, miss, cand) : 0;
+  case PF_BESTOFFSET:
+    return (miss || pf_hit) ? pf_bestoffset(pf, lineaddr, cand) : 0;
+  default:
+    return 0;
+  }
+}
@@ -0,0 +1,84 @@
+#ifndef PREFETCH_H
+#define PREFETCH_H
+
+#include "types.h"
+
+#define PF_NONE          0
+#define PF_NEXTLINE      1   // next degree lines after a miss
+#define PF_STRIDE        2   // PC-indexed reference prediction table
+#define PF_STREAM        3   // direction-confirmed streams around misses
+#define PF_BESTOFFSET    4   // best-offset (Michaud, HPCA 2016)
+
+#define PF_MAX_DEGREE    16
+#define PF_RPT_SIZE      256
+#define PF_STREAMS       16
+#define PF_STREAM_WINDOW 16  // lines a miss may be away from a stream's last
+#define PF_BO_OFFSETS    19
+#define PF_BO_RR_SIZE    256
+#define PF_INFLIGHT      64  // recent prefetch fills, to detect late ones
+#define PF_VICTIMS       4096 // lines recently evicted by prefetch fills
+
+//////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////
+
+typedef struct Prefetcher Prefetcher;
+
+typedef struct Pf_Rpt_Entry {
+  Addr  pc;
+  Addr  last_line;
+  int64 stride;
+  uns   conf;       // 0..3, prefetch from 2
+} Pf_Rpt_Entry;
+
+typedef struct Pf_Stream {
+  Flag  valid;
+  Addr  last_line;
+  int   dir;        // +1 or -1
+  uns   conf;       // misses seen in dir, prefetch from 2
+  uns64 last_use;   // for LRU replacement of streams
+} Pf_Stream;
+
+struct Prefetcher {
+  uns   type;
+  uns   degree;
+
+  Pf_Rpt_Entry rpt[PF_RPT_SIZE];
+  Pf_Stream    stream[PF_STREAMS];
+  uns64        stream_clock;
+
+  // best-offset: one offset is tested per access, scored against the
+  // recent requests table; the best one after a learning phase is used
+  Addr  bo_rr[PF_BO_RR_SIZE];
+  uns   bo_score[PF_BO_OFFSETS];
+  uns   bo_test;        // offset tested next
+  uns   bo_round;
+  int   bo_offset;      // 0: prefetching off
+  uns64 stat_bo_phases;
+
+  Addr  inflight_line[PF_INFLIGHT];
+  uns64 inflight_ready[PF_INFLIGHT];
+  uns   inflight_next;
+  Addr  victims[PF_VICTIMS];  // lineaddr+1, 0 is empty
+
+  // stats
+  uns64 stat_issued;      // prefetch fills
+  uns64 stat_redundant;   // candidates already in the cache
+  uns64 stat_useful;      // prefetched lines later hit by a demand
+  uns64 stat_late;        // ... before their fill had returned
+  uns64 stat_useless;     // prefetched lines evicted unused
+  uns64 stat_pollution;   // demand misses on lines a prefetch evicted
+  uns64 stat_demand_miss;
+};
+
+//////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////
+
+Prefetcher *prefetcher_new(uns type, uns degree);
+uns     prefetcher_train(Prefetcher *pf, Addr pc, Addr lineaddr, Flag miss, Flag pf_hit, Addr *cand);
+uns64   prefetcher_demand_hit(Prefetcher *pf, Addr lineaddr, uns64 delay);
+void    prefetcher_demand_miss(Prefetcher *pf, Addr lineaddr);
+void    prefetcher_fill(Prefetcher *pf, Addr lineaddr, uns64 ready_cycle);
+void    prefetcher_evict(Prefetcher *pf, Addr victim, Flag unused_prefetch, Flag by_prefetch);
+void    prefetcher_print_stats(Prefetcher *pf, char *header);
+
+#endif // PREFETCH_H
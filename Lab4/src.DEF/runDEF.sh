@@ -38,5 +38,17 @@
 
 
 
+########## ---------------  Fill check -------------- ################
+# A 64MB L2 holds both footprints, so every policy must take only the
+# compulsory misses LRU takes. More misses mean a policy evicts lines
+# while empty ways remain.
+
+ref=$(./sim -mode 4 -L2sizeKB 65536 -L2repl 0 ../traces/bzip2.mtr.gz ../traces/libq.mtr.gz | grep "L2CACHE_READ_MISS " | awk '{print $NF}')
+for repl in 1 3 4 5 6 7 8 9 10; do
+  miss=$(./sim -mode 4 -L2sizeKB 65536 -L2repl $repl ../traces/bzip2.mtr.gz ../traces/libq.mtr.gz | grep "L2CACHE_READ_MISS " | awk '{print $NF}')
+  [ "$miss" = "$ref" ] || echo "FILL CHECK FAILED: -L2repl $repl takes $miss L2 read misses, LRU $ref"
+done
+
+
 echo "All Done. Check the .res file in ../results directory";
 
@@ -9,10 +9,13 @@
 #include <string.h>
 #include <inttypes.h>
 #include <assert.h>
+#include <unistd.h>
+#include <pthread.h>
 
 #include "types.h"
 #include "memsys.h"
 #include "core.h"
+#include "sweep.h"
 
 #define PRINT_DOTS   1
 #define DOT_INTERVAL 100000
@@ -23,7 +26,7 @@
 
 MODE        SIM_MODE        = SIM_MODE_A;
 uns64       CACHE_LINESIZE  = 64;
-uns64       REPL_POLICY     = 0; // 0:LRU 1:RAND
+uns64       REPL_POLICY     = 0; // 0:LRU 1:RAND, 4-8: see cache.h
 
 uns64       DCACHE_SIZE     = 32*1024; 
 uns64       DCACHE_ASSOC    = 8; 
@@ -33,13 +36,85 @@ uns64       ICACHE_ASSOC    = 8;
 
 uns64       L2CACHE_SIZE    = 1024*1024; 
 uns64       L2CACHE_ASSOC   = 16;
-uns64       L2CACHE_REPL    = 0; // 0:LRU 1:RND 2:SWP 3:UCP
+uns64       L2CACHE_REPL    = 0; // 0:LRU 1:RND 2:SWP 3:UCP, 4-8: see cache.h
 
 uns64       SWP_CORE0_WAYS  = 0;
+uns64       SWP_WAYS[MAX_CORES];  // -SWP_ways, overrides SWP_CORE0_WAYS
+uns64       SWP_NUM_QUOTAS  = 0;
 
-// this number determined by number of traces you feed.
+// number of traces you feed, or -numcores (traces reused round robin)
 uns64       NUM_CORES       = 2;
 
+// jump over cycles in which every core is snoozing (-noskip to disable)
+Flag        CYCLE_SKIP      = 1;
+
+// decode the next trace block in a helper thread (default: if >1 cpu)
+Flag        TRACE_PREFETCH  = 2;
+
+// non-blocking memory: MSHRs per cache (0: blocking) and the number of
+// instructions a core may run past an unfinished load (0: stall on it)
+uns64       L1_MSHRS        = 0;
+uns64       L2_MSHRS        = 0;
+uns64       CORE_WINDOW     = 0;
+
+// write-back buffer entries at each L1 data cache and at the L2
+// (0: dirty victims are written back the moment they are evicted)
+uns64       L1_WBB_SIZE     = 0;
+uns64       L2_WBB_SIZE     = 0;
+
+// prefetchers at the L1 data caches and the L2, see prefetch.h for types
+uns64       L1_PREFETCHER   = 0;
+uns64       L2_PREFETCHER   = 0;
+uns64       PREFETCH_DEGREE = 1;
+
+// -mrc: LRU miss ratios of every L2 size from one run (see mrc.h)
+Flag        L2_MRC          = 0;
+
+// -sweep: many Part A caches from one pass over the trace (see sweep.h),
+// split over SWEEP_THREADS host threads (0: one per cpu)
+char        SWEEP_SPEC[4096];
+uns64       SWEEP_THREADS   = 0;
+
+// -L2sample: model only about 1/L2_SAMPLE of the L2 sets (or of each
+// -sweep cache) and estimate the rest (see Cache_Sample in cache.h), 0
+// or 1 models every set. The timing modes still run the cores, L1s and
+// DRAM in full; the tag-only -sweep skips the other sets outright.
+uns64       L2_SAMPLE       = 0;
+
+// -tlb: per-core L1 ITLB/DTLB and L2 TLB, misses walk the page table
+// through the L1 D-cache (modes D-F)
+Flag        TLB_ENABLE      = 0;
+uns64       L1TLB_ENTRIES   = 64;
+uns64       L1TLB_ASSOC     = 4;
+uns64       L2TLB_ENTRIES   = 1536;
+uns64       L2TLB_ASSOC     = 12;
+uns64       PAGE_SIZE_KB    = 4;   // 4 or 2048, TLB reach only: frames stay 4KB
+
+// -pagealloc: how pages get physical frames in modes D-F (see pagealloc.h)
+uns64       PAGE_ALLOC_POLICY = PAGE_ALLOC_FIXED;
+
+// -shared: all cores share one address space (no per-core page mapping),
+// L1 data caches kept coherent by a directory at the L2 (see directory.h)
+Flag        SHARED_MEM      = 0;
+uns64       COHERENCE       = COH_MESI;
+
+// -parallel: one host thread per core, L2/DRAM synced every QUANTUM cycles
+Flag        PARALLEL        = 0;
+uns64       QUANTUM         = 1000;
+
+// DRAM geometry and how line addresses map onto it (see dram.h)
+uns64       DRAM_CHANNELS   = 1;
+uns64       DRAM_RANKS      = 1;
+uns64       DRAM_BANKS      = 16; // per rank
+uns64       DRAM_ADDR_MAP   = DRAM_MAP_ROW_BANK_COL;
+
+// DRAM controller with bank timing, a shared bus and a write queue
+// (default: the fixed row buffer latencies of Part C)
+Flag        DRAM_CTL        = 0;
+uns64       DRAM_PAGE_POLICY = DRAM_PAGE_OPEN;
+uns64       DRAM_SCHED      = DRAM_SCHED_FRFCFS;
+uns64       DRAM_WQ_SIZE    = 32;
+
 
 /***************************************************************************************
  * Functions
@@ -49,6 +124,8 @@ void die_usage();
 void die_message(const char * msg);
 void get_params(int argc, char** argv);
 void print_stats();
+uns64 next_event_cycle(void);
+void run_parallel(void);
 
 /***************************************************************************************
  * Globals
@@ -58,7 +135,12 @@ Memsys      *memsys;
 Core        *core[MAX_CORES];
 char        trace_filename[MAX_CORES][1024];
 uns64       last_printdot_cycle;
-uns64       cycle;
+__thread uns64 cycle;            // per thread, each -parallel core keeps its own
+uns64       stat_loop_iters;     // main loop iterations (quanta in -parallel)
+
+pthread_barrier_t par_barrier;
+uns64       par_quantum_end;
+Flag        par_exit;
 
 /***************************************************************************************
  * Main
@@ -71,8 +153,18 @@ int main(int argc, char** argv)
 
     get_params(argc, argv);
 
+    if(TRACE_PREFETCH == 2){
+      TRACE_PREFETCH = (sysconf(_SC_NPROCESSORS_ONLN) > 1);
+    }
+
     assert(NUM_CORES<=MAX_CORES);
 
+    if(SWEEP_SPEC[0]){
+      sweep_parse(SWEEP_SPEC);
+      sweep_run(trace_filename[0], SWEEP_THREADS ? SWEEP_THREADS : (uns64)sysconf(_SC_NPROCESSORS_ONLN));
+      return 0;
+    }
+
     //---- Initiliaze the system
     memsys = memsys_new();
 
@@ -82,6 +174,12 @@ int main(int argc, char** argv)
 
     print_dots();
 
+    if(PARALLEL){
+      run_parallel();
+      print_stats();
+      return 0;
+    }
+
     //--------------------------------------------------------------------
     // -- Iterate until all cores are done
     //--------------------------------------------------------------------
@@ -99,7 +197,8 @@ int main(int argc, char** argv)
 	print_dots();
       }
       
-      cycle++; 
+      stat_loop_iters++;
+      cycle = next_event_cycle();
     }
     
     print_stats();
@@ -115,6 +214,14 @@ void print_stats(){
 
   printf("\n");
   printf("\nCYCLES      \t\t\t : %10llu", cycle);
+  if(PARALLEL){
+    printf("\nSIM_QUANTA      \t\t : %10llu", stat_loop_iters);
+  }
+  else{
+    printf("\nSIM_LOOP_ITERS  \t\t : %10llu", stat_loop_iters);
+    printf("\nSIM_CYCLE_SKIP_SPEEDUP\t\t : %10.3f",
+           stat_loop_iters ? (double)cycle/(double)stat_loop_iters : 0.0);
+  }
   
   for(ii=0; ii<NUM_CORES; ii++){
     core_print_stats(core[ii]);
@@ -125,6 +232,116 @@ void print_stats(){
   printf("\n\n");
 }
 
+//--------------------------------------------------------------------
+// -- Next cycle in which some core does work. A core acts only once
+// -- cycle > snooze_end_cycle and nothing else in the system keeps
+// -- time, so the skipped cycles would have been no-ops. Stop at the
+// -- next heartbeat so the dots come out the same.
+//--------------------------------------------------------------------
+
+uns64 next_event_cycle(){
+  uns64 next = cycle+1;
+  uns64 wake = ~0ULL;
+  uns ii;
+
+  if(!CYCLE_SKIP){
+    return next;
+  }
+
+  for(ii=0; ii<NUM_CORES; ii++){
+    if(!core[ii]->done && core[ii]->snooze_end_cycle+1 < wake){
+      wake = core[ii]->snooze_end_cycle+1;
+    }
+  }
+
+  if(wake != ~0ULL && wake > next){
+    next = wake;
+    if(next > last_printdot_cycle + DOT_INTERVAL){
+      next = last_printdot_cycle + DOT_INTERVAL;
+    }
+  }
+
+  return next;
+}
+
+//--------------------------------------------------------------------
+// -- Parallel mode. Each core thread simulates one quantum on its
+// -- private L1s, timing L2 accesses against the state left by the
+// -- previous barrier (see memsys_par_replay). Between the two barrier
+// -- waits only the core threads run; after them only this thread, which
+// -- applies the logged L2 accesses. Results do not depend on how the
+// -- host schedules the threads.
+//--------------------------------------------------------------------
+
+void *par_core_thread(void *arg){
+  Core *c = (Core *) arg;
+
+  while(1){
+    pthread_barrier_wait(&par_barrier);
+    if(par_exit){
+      break;
+    }
+
+    cycle = par_quantum_end - QUANTUM;
+    while(!c->done && cycle < par_quantum_end){
+      core_cycle(c);
+      cycle++;
+      if(CYCLE_SKIP && c->snooze_end_cycle+1 > cycle){
+        cycle = c->snooze_end_cycle+1;
+      }
+    }
+
+    pthread_barrier_wait(&par_barrier);
+  }
+
+  return NULL;
+}
+
+void run_parallel(){
+  pthread_t thread[MAX_CORES];
+  Flag all_cores_done=0;
+  uns ii;
+
+  memsys_par_enable(memsys);
+  pthread_barrier_init(&par_barrier, NULL, NUM_CORES+1);
+  for(ii=0; ii<NUM_CORES; ii++){
+    pthread_create(&thread[ii], NULL, par_core_thread, core[ii]);
+  }
+
+  while( ! (all_cores_done) ){
+    par_quantum_end = cycle + QUANTUM;
+    pthread_barrier_wait(&par_barrier);   // cores run the quantum
+    pthread_barrier_wait(&par_barrier);
+    memsys_par_replay(memsys);
+
+    cycle = par_quantum_end;
+    all_cores_done=1;
+    for(ii=0; ii<NUM_CORES; ii++){
+      all_cores_done &= core[ii]->done;
+    }
+    stat_loop_iters++;
+
+    if (cycle - last_printdot_cycle >= DOT_INTERVAL){
+      print_dots();
+    }
+  }
+
+  par_exit = 1;
+  pthread_barrier_wait(&par_barrier);
+  for(ii=0; ii<NUM_CORES; ii++){
+    pthread_join(thread[ii], NULL);
+  }
+  pthread_barrier_destroy(&par_barrier);
+
+  // same end point as the sequential loop: one past the last retirement
+  cycle = 0;
+  for(ii=0; ii<NUM_CORES; ii++){
+    if(core[ii]->done_cycle_count+1 > cycle){
+      cycle = core[ii]->done_cycle_count+1;
+    }
+  }
+}
+
 //--------------------------------------------------------------------
 // -- Print Hearbeats 
 //--------------------------------------------------------------------
@@ -156,16 +373,52 @@ void print_dots(){
 //--------------------------------------------------------------------
 
 void die_usage() {
-    printf("Usage : sim [-option <value>] trace_0 <trace_1> \n");
+    printf("Usage : sim [-option <value>] trace_0 <trace_1> ... <trace_%d>\n", MAX_CORES-1);
     printf("   Options\n");
     printf("      -mode            <num>    Set mode of the simulator[1:PartA, 2:PartB, 3:PartC 4:PartD 5:PartE]  (Default: 1)\n");
     printf("      -linesize        <num>    Set cache linesize for all caches (Default:64)\n");
-    printf("      -repl            <num>    Set replacement policy for L1 cache [0:LRU,1:RND] (Default:0)\n");
+    printf("      -repl            <num>    Set replacement policy for L1 cache [0:LRU,1:RND,4:AGELRU,5:PLRU,6:SRRIP,7:BRRIP,8:DRRIP] (Default:0)\n");
     printf("      -DsizeKB         <num>    Set capacity in KB of the the Level 1 DCACHE (Default:32 KB)\n");
     printf("      -Dassoc          <num>    Set associativity of the the Level 1 DCACHE (Default:8)\n");
     printf("      -L2sizeKB        <num>    Set capacity in KB of the unified Level 2 cache (Default: 512 KB)\n");
-    printf("      -L2repl          <num>    Set replacement policy for L2 cache [0:LRU,1:RND,2:SWP] (Default:0)\n");
-    printf("      -SWP_core0ways   <num>    Set static quota for core_0 for SWP (Default:1)\n");
+    printf("      -L2repl          <num>    Set replacement policy for L2 cache [0:LRU,1:RND,2:SWP,3:UCP,4:AGELRU,5:PLRU,6:SRRIP,7:BRRIP,8:DRRIP,9:TADIP,10:TADRRIP] (Default:0)\n");
+    printf("      -SWP_core0ways   <num>    Set static quota for core_0 for SWP, other cores split the rest (Default:1)\n");
+    printf("      -SWP_ways        <list>   Set static SWP quota of every core, comma separated (e.g. 8,4,2,2)\n");
+    printf("      -traceprefetch   <0/1>    Decode the next trace block in a helper thread (Default: 1 if >1 cpu)\n");
+    printf("      -L1mshrs         <num>    MSHRs per L1 cache, 0 models a blocking cache, 1 with -window (Default:0)\n");
+    printf("      -L2mshrs         <num>    MSHRs in the L2 cache, 0 models a blocking cache, 1 with -window (Default:0)\n");
+    printf("      -window          <num>    Instructions a core may issue past a load miss, 0 blocks on it (Default:0)\n");
+    printf("      -L1wbb           <num>    Write-back buffer entries per L1 data cache, 0 writes back at once (Default:0)\n");
+    printf("      -L2wbb           <num>    Write-back buffer entries in the L2 cache, 0 writes back at once (Default:0)\n");
+    printf("      -L1pf            <num>    L1 data cache prefetcher [0:none,1:nextline,2:stride,3:stream,4:bestoffset] (Default:0)\n");
+    printf("      -L2pf            <num>    L2 cache prefetcher, same choices as -L1pf (Default:0)\n");
+    printf("      -pfdegree        <num>    Lines prefetched per trigger (Default:1, Max:%d)\n", PF_MAX_DEGREE);
+    printf("      -mrc                      Print L2 LRU miss ratios for all set counts and ways from one pass (modes 2-6)\n");
+    printf("      -L2sample        <num>    Model about 1 in <num> L2 (or -sweep) sets and estimate the miss ratio with error bounds (Default:0, all)\n");
+    printf("      -sweep           <list>   Part A caches to simulate in one pass, sizeKB:assoc:linesize:repl comma separated,\n");
+    printf("                                '/' lists alternatives in a field (e.g. 16/32/64:4/8:64:0,32:8:32/128:6)\n");
+    printf("      -sweepthreads    <num>    Host threads sharing the -sweep caches (Default: one per cpu, Max:%d)\n", SWEEP_MAX_THREADS);
+    printf("      -tlb                      Model per-core TLBs and page walks through the L1 D-cache (modes 4-6)\n");
+    printf("      -L1tlbent        <num>    Entries in each L1 ITLB and DTLB (Default:64)\n");
+    printf("      -L1tlbassoc      <num>    Associativity of the L1 TLBs (Default:4)\n");
+    printf("      -L2tlbent        <num>    Entries in each core's L2 TLB (Default:1536)\n");
+    printf("      -L2tlbassoc      <num>    Associativity of the L2 TLB (Default:12)\n");
+    printf("      -pagesizeKB      <num>    Page size the TLBs map, 4 or 2048; frames stay 4KB, so 2048 only widens TLB reach (Default:4)\n");
+    printf("      -pagealloc       <num>    Frame allocation [0:fixed formula,1:first-touch sequential,2:random,3:L2 set colors per core,4:DRAM banks per core] (Default:0)\n");
+    printf("      -shared                   One address space for all cores, coherent L1 data caches (modes 4-6)\n");
+    printf("      -coh             <num>    Coherence protocol with -shared [0:MESI,1:MOESI] (Default:0)\n");
+    printf("      -parallel                 Simulate each core on its own host thread (modes 4-6)\n");
+    printf("      -quantum         <num>    Cycles between L2/DRAM synchronizations in -parallel (Default:1000)\n");
+    printf("      -dramch          <num>    DRAM channels, each with its own bus (Default:1, Max:%d)\n", MAX_DRAM_CHANNELS);
+    printf("      -dramranks       <num>    DRAM ranks per channel (Default:1)\n");
+    printf("      -drambanks       <num>    DRAM banks per rank (Default:16)\n");
+    printf("      -drammap         <num>    DRAM address mapping [0:row:bank:col,1:XOR bank hash,2:line channel interleave] (Default:0)\n");
+    printf("      -dramctl                  Model DRAM bank timing, bus contention and a write queue (modes 3-6)\n");
+    printf("      -drampage        <num>    Page policy with -dramctl [0:open,1:closed] (Default:0)\n");
+    printf("      -dramsched       <num>    Write scheduling with -dramctl [0:FCFS,1:FR-FCFS] (Default:1)\n");
+    printf("      -dramwq          <num>    Write queue entries with -dramctl (Default:32)\n");
+    printf("      -noskip                   Step every cycle instead of skipping cycles where all cores snooze\n");
+    printf("      -numcores        <num>    Number of cores, traces are reused round robin (Default: num traces, Max:%d)\n", MAX_CORES);
     exit(0);
 }
 
@@ -186,6 +439,7 @@ void die_message(const char * msg) {
 void get_params(int argc, char** argv){
   int   ii;
   int  num_trace_filename=0;
+  int  num_cores_param=0;
 
   if (argc < 2) {
     die_usage();
@@ -255,6 +509,241 @@ void get_params(int argc, char** argv){
 		    ii += 1;
 		}
 	    }
+
+	    else if (!strcmp(argv[ii], "-SWP_ways")) {
+		if (ii < argc - 1) {
+		    char *tok = strtok(argv[ii+1], ",");
+		    SWP_NUM_QUOTAS = 0;
+		    while (tok && SWP_NUM_QUOTAS < MAX_CORES) {
+			SWP_WAYS[SWP_NUM_QUOTAS++] = atoi(tok);
+			tok = strtok(NULL, ",");
+		    }
+		    ii += 1;
+		}
+	    }
+
+	    else if (!strcmp(argv[ii], "-traceprefetch")) {
+		if (ii < argc - 1) {
+		    TRACE_PREFETCH = (atoi(argv[ii+1]) != 0);
+		    ii += 1;
+		}
+	    }
+
+	    else if (!strcmp(argv[ii], "-L1mshrs")) {
+		if (ii < argc - 1) {
+		    L1_MSHRS = atoi(argv[ii+1]);
+		    ii += 1;
+		}
+	    }
+
+	    else if (!strcmp(argv[ii], "-L2mshrs")) {
+		if (ii < argc - 1) {
+		    L2_MSHRS = atoi(argv[ii+1]);
+		    ii += 1;
+		}
+	    }
+
+	    else if (!strcmp(argv[ii], "-window")) {
+		if (ii < argc - 1) {
+		    CORE_WINDOW = atoi(argv[ii+1]);
+		    ii += 1;
+		}
+	    }
+
+	    else if (!strcmp(argv[ii], "-L1wbb")) {
+		if (ii < argc - 1) {
+		    L1_WBB_SIZE = atoi(argv[ii+1]);
+		    ii += 1;
+		}
+	    }
+
+	    else if (!strcmp(argv[ii], "-L2wbb")) {
+		if (ii < argc - 1) {
+		    L2_WBB_SIZE = atoi(argv[ii+1]);
+		    ii += 1;
+		}
+	    }
+
+	    else if (!strcmp(argv[ii], "-L1pf")) {
+		if (ii < argc - 1) {
+		    L1_PREFETCHER = atoi(argv[ii+1]);
+		    ii += 1;
+		}
+	    }
+
+	    else if (!strcmp(argv[ii], "-L2pf")) {
+		if (ii < argc - 1) {
+		    L2_PREFETCHER = atoi(argv[ii+1]);
+		    ii += 1;
+		}
+	    }
+
+	    else if (!strcmp(argv[ii], "-pfdegree")) {
+		if (ii < argc - 1) {
+		    PREFETCH_DEGREE = atoi(argv[ii+1]);
+		    ii += 1;
+		}
+	    }
+
+	    else if (!strcmp(argv[ii], "-mrc")) {
+		L2_MRC = 1;
+	    }
+
+	    else if (!strcmp(argv[ii], "-L2sample")) {
+		if (ii < argc - 1) {
+		    L2_SAMPLE = atoi(argv[ii+1]);
+		    ii += 1;
+		}
+	    }
+
+	    else if (!strcmp(argv[ii], "-sweep")) {
+		if (ii < argc - 1) {
+		    if (strlen(argv[ii+1]) >= sizeof(SWEEP_SPEC)) {
+			die_message("-sweep list too long");
+		    }
+		    strcpy(SWEEP_SPEC, argv[ii+1]);
+		    ii += 1;
+		}
+	    }
+
+	    else if (!strcmp(argv[ii], "-sweepthreads")) {
+		if (ii < argc - 1) {
+		    SWEEP_THREADS = atoi(argv[ii+1]);
+		    ii += 1;
+		}
+	    }
+
+	    else if (!strcmp(argv[ii], "-tlb")) {
+		TLB_ENABLE = 1;
+	    }
+
+	    else if (!strcmp(argv[ii], "-L1tlbent")) {
+		if (ii < argc - 1) {
+		    L1TLB_ENTRIES = atoi(argv[ii+1]);
+		    ii += 1;
+		}
+	    }
+
+	    else if (!strcmp(argv[ii], "-L1tlbassoc")) {
+		if (ii < argc - 1) {
+		    L1TLB_ASSOC = atoi(argv[ii+1]);
+		    ii += 1;
+		}
+	    }
+
+	    else if (!strcmp(argv[ii], "-L2tlbent")) {
+		if (ii < argc - 1) {
+		    L2TLB_ENTRIES = atoi(argv[ii+1]);
+		    ii += 1;
+		}
+	    }
+
+	    else if (!strcmp(argv[ii], "-L2tlbassoc")) {
+		if (ii < argc - 1) {
+		    L2TLB_ASSOC = atoi(argv[ii+1]);
+		    ii += 1;
+		}
+	    }
+
+	    else if (!strcmp(argv[ii], "-pagesizeKB")) {
+		if (ii < argc - 1) {
+		    PAGE_SIZE_KB = atoi(argv[ii+1]);
+		    ii += 1;
+		}
+	    }
+
+	    else if (!strcmp(argv[ii], "-pagealloc")) {
+		if (ii < argc - 1) {
+		    PAGE_ALLOC_POLICY = atoi(argv[ii+1]);
+		    ii += 1;
+		}
+	    }
+
+	    else if (!strcmp(argv[ii], "-shared")) {
+		SHARED_MEM = 1;
+	    }
+
+	    else if (!strcmp(argv[ii], "-coh")) {
+		if (ii < argc - 1) {
+		    COHERENCE = atoi(argv[ii+1]);
+		    ii += 1;
+		}
+	    }
+
+	    else if (!strcmp(argv[ii], "-parallel")) {
+		PARALLEL = 1;
+	    }
+
+	    else if (!strcmp(argv[ii], "-quantum")) {
+		if (ii < argc - 1) {
+		    QUANTUM = atoi(argv[ii+1]);
+		    ii += 1;
+		}
+	    }
+
+	    else if (!strcmp(argv[ii], "-dramch")) {
+		if (ii < argc - 1) {
+		    DRAM_CHANNELS = atoi(argv[ii+1]);
+		    ii += 1;
+		}
+	    }
+
+	    else if (!strcmp(argv[ii], "-dramranks")) {
+		if (ii < argc - 1) {
+		    DRAM_RANKS = atoi(argv[ii+1]);
+		    ii += 1;
+		}
+	    }
+
+	    else if (!strcmp(argv[ii], "-drambanks")) {
+		if (ii < argc - 1) {
+		    DRAM_BANKS = atoi(argv[ii+1]);
+		    ii += 1;
+		}
+	    }
+
+	    else if (!strcmp(argv[ii], "-drammap")) {
+		if (ii < argc - 1) {
+		    DRAM_ADDR_MAP = atoi(argv[ii+1]);
+		    ii += 1;
+		}
+	    }
+
+	    else if (!strcmp(argv[ii], "-dramctl")) {
+		DRAM_CTL = 1;
+	    }
+
+	    else if (!strcmp(argv[ii], "-drampage")) {
+		if (ii < argc - 1) {
+		    DRAM_PAGE_POLICY = atoi(argv[ii+1]);
+		    ii += 1;
+		}
+	    }
+
+	    else if (!strcmp(argv[ii], "-dramsched")) {
+		if (ii < argc - 1) {
+		    DRAM_SCHED = atoi(argv[ii+1]);
+		    ii += 1;
+		}
+	    }
+
+	    else if (!strcmp(argv[ii], "-dramwq")) {
+		if (ii < argc - 1) {
+		    DRAM_WQ_SIZE = atoi(argv[ii+1]);
+		    ii += 1;
+		}
+	    }
+
+	    else if (!strcmp(argv[ii], "-noskip")) {
+		CYCLE_SKIP = 0;
+	    }
+
+	    else if (!strcmp(argv[ii], "-numcores")) {
+		if (ii < argc - 1) {
+		    num_cores_param = atoi(argv[ii+1]);
+		    ii += 1;
+		}
+	    }
 	    
 	    else {
 		char msg[256];
@@ -269,7 +758,7 @@ void get_params(int argc, char** argv){
 	}
 	else {
 	    char msg[256];
-	    sprintf(msg, "Invalid option %s, got filename %s", argv[ii], trace_filename[NUM_CORES]);
+	    sprintf(msg, "Too many trace files (max %d), got %s", MAX_CORES, argv[ii]);
 	    die_message(msg);
 	}    
     }
@@ -281,6 +770,98 @@ void get_params(int argc, char** argv){
 	die_message("Must provide at least one trace file");
     }
 
+    if (num_cores_param) {
+	if (num_cores_param < num_trace_filename || num_cores_param > MAX_CORES) {
+	    die_message("-numcores must be between the number of traces and MAX_CORES");
+	}
+	for (ii = num_trace_filename; ii < num_cores_param; ii++) {
+	    strcpy(trace_filename[ii], trace_filename[ii % num_trace_filename]);
+	}
+	NUM_CORES = num_cores_param;
+    }
+
+    if (SWEEP_SPEC[0] && (num_trace_filename != 1 || PARALLEL)) {
+	die_message("-sweep takes exactly one trace and cannot be combined with -parallel");
+    }
+
+    if (PARALLEL) {
+	if (SIM_MODE < SIM_MODE_D || QUANTUM == 0) {
+	    die_message("-parallel needs per-core L1s (-mode 4-6) and a nonzero -quantum");
+	}
+	if (REPL_POLICY == 1) {
+	    die_message("-parallel needs a deterministic L1 policy (RND shares rand())");
+	}
+	if (SHARED_MEM) {
+	    die_message("-parallel cannot keep L1s coherent (-shared touches other cores' caches)");
+	}
+	if (PAGE_ALLOC_POLICY != PAGE_ALLOC_FIXED) {
+	    die_message("-parallel needs the fixed page mapping (-pagealloc allocates from shared frames)");
+	}
+	if (L2_SAMPLE > 1) {
+	    die_message("-parallel cannot time accesses to sets -L2sample does not model");
+	}
+	if (L2_WBB_SIZE) {
+	    die_message("-parallel cannot stall cores on a full -L2wbb (the L2 is updated at the barrier)");
+	}
+	if (L2_MSHRS || CORE_WINDOW) {
+	    die_message("-parallel cannot stall cores on busy L2 MSHRs (-L2mshrs, or the one -window implies)");
+	}
+    }
+
+    if (DRAM_CHANNELS == 0 || DRAM_CHANNELS > MAX_DRAM_CHANNELS || DRAM_RANKS == 0 || DRAM_BANKS == 0 ||
+	DRAM_CHANNELS*DRAM_RANKS*DRAM_BANKS > MAX_DRAM_BANKS) {
+	die_message("DRAM channels x ranks x banks must be between 1 and MAX_DRAM_BANKS");
+    }
+
+    if (DRAM_ADDR_MAP > DRAM_MAP_LINE_CHANNEL ||
+	(DRAM_ADDR_MAP == DRAM_MAP_XOR && (DRAM_BANKS & (DRAM_BANKS-1)))) {
+	die_message("-drammap must be 0-2, and XOR hashing needs a power of two -drambanks");
+    }
+
+    if (DRAM_CTL && DRAM_WQ_SIZE < 4) {
+	die_message("-dramwq must be at least 4");
+    }
+
+    if (TLB_ENABLE) {
+	if (SIM_MODE < SIM_MODE_D) {
+	    die_message("-tlb needs per-core caches (-mode 4-6)");
+	}
+	if (L1TLB_ASSOC == 0 || L1TLB_ASSOC > MAX_WAYS || L1TLB_ENTRIES % L1TLB_ASSOC ||
+	    L2TLB_ASSOC == 0 || L2TLB_ASSOC > MAX_WAYS || L2TLB_ENTRIES % L2TLB_ASSOC ||
+	    L1TLB_ENTRIES == 0 || L2TLB_ENTRIES == 0) {
+	    die_message("TLB entries must be a nonzero multiple of an associativity up to MAX_WAYS");
+	}
+	if (PAGE_SIZE_KB != 4 && PAGE_SIZE_KB != 2048) {
+	    die_message("-pagesizeKB must be 4 or 2048");
+	}
+	if (PAGE_SIZE_KB == 2048 && PAGE_ALLOC_POLICY != PAGE_ALLOC_FIXED) {
+	    die_message("-pagesizeKB 2048 only changes TLB reach; -pagealloc still hands out and colors 4KB frames");
+	}
+    }
+
+    if (PAGE_ALLOC_POLICY > PAGE_ALLOC_BANKCOLOR ||
+	(PAGE_ALLOC_POLICY != PAGE_ALLOC_FIXED && SIM_MODE < SIM_MODE_D)) {
+	die_message("-pagealloc must be 0-4, and needs address translation (-mode 4-6)");
+    }
+
+    if (SHARED_MEM) {
+	if (SIM_MODE < SIM_MODE_D || COHERENCE > COH_MOESI) {
+	    die_message("-shared needs per-core caches (-mode 4-6), and -coh must be 0 or 1");
+	}
+	if (PAGE_ALLOC_POLICY != PAGE_ALLOC_FIXED || L1_PREFETCHER ||
+	    L2CACHE_REPL == REPL_SWP || L2CACHE_REPL == REPL_UCP) {
+	    die_message("-shared cannot be combined with -pagealloc, -L1pf (fills bypass the directory), or SWP/UCP (lines have no owner core)");
+	}
+    }
+
+    if (L2_SAMPLE > 1 && SIM_MODE == SIM_MODE_A && !SWEEP_SPEC[0]) {
+	die_message("-L2sample needs an L2 (-mode 2-6) or -sweep");
+    }
+
+    if (SWP_NUM_QUOTAS && SWP_NUM_QUOTAS != NUM_CORES) {
+	die_message("-SWP_ways needs one quota per core");
+    }
+
 
   
 }
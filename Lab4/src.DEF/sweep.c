@@ -0,0 +1,265 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <pthread.h>
+
+#include "sweep.h"
+#include "core.h"
+
+extern __thread uns64 cycle;
+
+extern uns64 L2_SAMPLE;
+
+extern void die_message(const char * msg);
+
+static Sweep_Config sweep_cfg[SWEEP_MAX_CONFIGS];
+static uns          sweep_num_cfg;
+
+static pthread_barrier_t sweep_barrier;
+static Trace_Block *sweep_block;     // NULL tells the workers to exit
+static uns64        sweep_base;      // instructions before sweep_block
+static uns          sweep_threads;
+
+// the loads and stores of sweep_block, extracted once for every config
+typedef struct Sweep_Access {
+  Addr  addr;
+  uns   rr;        // record index in the block, for the LRU timestamps
+  Flag  is_write;
+} Sweep_Access;
+
+static Sweep_Access sweep_acc[TRACE_BLOCK_RECS];
+static uns          sweep_num_acc;
+
+
+////////////////////////////////////////////////////////////////////
+// Spec parsing
+////////////////////////////////////////////////////////////////////
+
+#define SWEEP_MAX_ALTS 32
+
+static uns sweep_parse_alts(char *field, uns64 *alts){
+  uns num = 0;
+  char *save, *tok;
+
+  for(tok = strtok_r(field, "/", &save); tok; tok = strtok_r(NULL, "/", &save)){
+    if(num == SWEEP_MAX_ALTS){
+      die_message("-sweep: too many alternatives in one field");
+    }
+    alts[num++] = strtoull(tok, NULL, 10);
+  }
+  return num;
+}
+
+static void sweep_add(uns64 size_kb, uns64 assoc, uns64 linesize, uns64 repl){
+  Sweep_Config *cfg = &sweep_cfg[sweep_num_cfg];
+
+  if(sweep_num_cfg == SWEEP_MAX_CONFIGS){
+    die_message("-sweep: too many configurations");
+  }
+  if(assoc == 0 || assoc > MAX_WAYS || linesize == 0 || size_kb*1024 < assoc*linesize){
+    die_message("-sweep: each cache needs 1..MAX_WAYS ways and at least one set");
+  }
+  // the rest need several cores (SWP, UCP, TA policies)
+  if(repl != REPL_LRU && repl != REPL_RND && (repl < REPL_AGELRU || repl > REPL_DRRIP)){
+    die_message("-sweep: repl must be 0, 1 or 4-8");
+  }
+
+  cfg->size_kb  = size_kb;
+  cfg->assoc    = assoc;
+  cfg->linesize = linesize;
+  cfg->repl     = repl;
+  sweep_num_cfg++;
+}
+
+void    sweep_parse(char *spec){
+  uns64 alts[4][SWEEP_MAX_ALTS];
+  uns num[4];
+  char *save, *group;
+
+  for(group = strtok_r(spec, ",", &save); group; group = strtok_r(NULL, ",", &save)){
+    char *field[4];
+    uns f, a, b, c, d;
+
+    for(f=0; f<4; f++){
+      field[f] = group;
+      group = strchr(group, ':');
+      if(!group && f < 3){
+        die_message("-sweep: expected sizeKB:assoc:linesize:repl");
+      }
+      if(group){
+        *group++ = '\0';
+      }
+    }
+    for(f=0; f<4; f++){
+      num[f] = sweep_parse_alts(field[f], alts[f]);
+    }
+
+    for(a=0; a<num[0]; a++){
+      for(b=0; b<num[1]; b++){
+        for(c=0; c<num[2]; c++){
+          for(d=0; d<num[3]; d++){
+            sweep_add(alts[0][a], alts[1][b], alts[2][c], alts[3][d]);
+          }
+        }
+      }
+    }
+  }
+
+  if(sweep_num_cfg == 0){
+    die_message("-sweep: no configurations given");
+  }
+}
+
+////////////////////////////////////////////////////////////////////
+// The block loop. Each configuration sees the accesses of Part A:
+// loads and stores, write-allocate, one instruction per cycle.
+////////////////////////////////////////////////////////////////////
+
+static void sweep_extract(void){
+  uns rr;
+
+  sweep_num_acc = 0;
+  for(rr=0; rr<sweep_block->num_recs; rr++){
+    Trace_Rec *r = &sweep_block->rec[rr];
+    if(r->inst_type == INST_TYPE_LOAD || r->inst_type == INST_TYPE_STORE){
+      Sweep_Access *a = &sweep_acc[sweep_num_acc++];
+      a->addr     = r->ldst_addr;
+      a->rr       = rr;
+      a->is_write = (r->inst_type == INST_TYPE_STORE);
+    }
+  }
+}
+
+static void sweep_run_shard(uns tid){
+  uns ii, aa;
+
+  for(ii=tid; ii<sweep_num_cfg; ii+=sweep_threads){
+    Cache *c = sweep_cfg[ii].cache;
+    uns64 linesize = sweep_cfg[ii].linesize;
+    uns   shift = __builtin_ctzll(linesize);
+    Flag  pow2  = (linesize == (1ULL << shift)); // no divide per access
+
+    for(aa=0; aa<sweep_num_acc; aa++){
+      Sweep_Access *a = &sweep_acc[aa];
+      Addr lineaddr = pow2 ? a->addr >> shift : a->addr/linesize;
+      if(c->sample && cache_sample_skip(c, lineaddr, a->is_write)){
+        continue;
+      }
+      cycle = sweep_base + a->rr;   // LRU timestamps
+      if(cache_access(c, lineaddr, a->is_write, 0) == MISS){
+        cache_install(c, lineaddr, a->is_write, 0);
+      }
+    }
+  }
+}
+
+static void *sweep_worker(void *arg){
+  uns tid = (uns)(uintptr_t) arg;
+
+  while(1){
+    pthread_barrier_wait(&sweep_barrier);
+    if(!sweep_block){
+      return NULL;
+    }
+    sweep_run_shard(tid);
+    pthread_barrier_wait(&sweep_barrier);
+  }
+}
+
+// With -L2sample the counts are estimates for every set and err is the
+// half width of the 95% confidence interval of missperc
+static void sweep_print_stats(uns64 num_inst){
+  uns ii;
+
+  printf("\n");
+  printf("\nSWEEP_INST      \t\t : %10llu", num_inst);
+  printf("\nSWEEP_CONFIGS   \t\t : %10u", sweep_num_cfg);
+  printf("\nSWEEP_THREADS   \t\t : %10u", sweep_threads);
+  if(L2_SAMPLE > 1){
+    printf("\nSWEEP_SAMPLE    \t\t : %10llu", L2_SAMPLE);
+  }
+  printf("\nSWEEP_CONFIG    \t\t :     sizeKB  assoc linesize repl     access       miss   missperc dirty_evicts%s",
+         L2_SAMPLE > 1 ? "      err" : "");
+  for(ii=0; ii<sweep_num_cfg; ii++){
+    Sweep_Config *cfg = &sweep_cfg[ii];
+    Cache *c = cfg->cache;
+    uns64 access = c->stat_read_access + c->stat_write_access;
+    uns64 miss   = c->stat_read_miss + c->stat_write_miss;
+    uns64 dirty  = c->stat_dirty_evicts;
+    double mr    = access ? (double)miss/(double)access : 0.0;
+    double err   = 0;
+    if(c->sample){
+      mr    = cache_sample_estimate(c, TRUE, &access, &err);
+      miss  = (uns64)(mr*access + 0.5);
+      dirty = cache_sample_dirty_evicts(c);
+    }
+    printf("\nSWEEP_%-4u      \t\t : %10llu %6llu %8llu %4llu %10llu %10llu %10.3f %12llu", ii,
+           cfg->size_kb, cfg->assoc, cfg->linesize, cfg->repl, access, miss, 100*mr, dirty);
+    if(c->sample){
+      printf(" %8.3f", 100*err);
+    }
+  }
+  printf("\n\n");
+}
+
+////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////
+
+void    sweep_run(char *trace_filename, uns num_threads){
+  pthread_t tids[SWEEP_MAX_THREADS];
+  Core *reader = (Core *) calloc (1, sizeof (Core));
+  uns64 num_inst = 0;
+  uns ii;
+
+  sweep_threads = num_threads;
+  if(sweep_threads > sweep_num_cfg){
+    sweep_threads = sweep_num_cfg;
+  }
+  if(sweep_threads > SWEEP_MAX_THREADS){
+    sweep_threads = SWEEP_MAX_THREADS;
+  }
+  for(ii=0; ii<sweep_num_cfg; ii++){
+    Sweep_Config *cfg = &sweep_cfg[ii];
+    if(cfg->repl == REPL_RND && sweep_threads > 1){
+      die_message("-sweep: RND shares rand(), use -sweepthreads 1");
+    }
+    cfg->cache = cache_new(cfg->size_kb*1024, cfg->assoc, cfg->linesize, cfg->repl);
+    if(L2_SAMPLE > 1){
+      cache_sample_init(cfg->cache, L2_SAMPLE);
+    }
+  }
+
+  strcpy(reader->trace_fname, trace_filename);
+  core_init_trace(reader);
+
+  pthread_barrier_init(&sweep_barrier, NULL, sweep_threads);
+  for(ii=1; ii<sweep_threads; ii++){
+    pthread_create(&tids[ii], NULL, sweep_worker, (void *)(uintptr_t) ii);
+  }
+
+  // the main thread is worker 0; the next block decodes meanwhile
+  // when TRACE_PREFETCH is on
+  while((sweep_block = core_next_block(reader))){
+    sweep_base = num_inst;
+    sweep_extract();
+    if(sweep_threads > 1){
+      pthread_barrier_wait(&sweep_barrier);
+    }
+    sweep_run_shard(0);
+    if(sweep_threads > 1){
+      pthread_barrier_wait(&sweep_barrier);
+    }
+    num_inst += sweep_block->num_recs;
+  }
+
+  if(sweep_threads > 1){
+    pthread_barrier_wait(&sweep_barrier);
+    for(ii=1; ii<sweep_threads; ii++){
+      pthread_join(tids[ii], NULL);
+    }
+  }
+
+  sweep_print_stats(num_inst);
+}
@@ -0,0 +1,35 @@
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include "types.h"
+#include "cache.h"
+
+#define SWEEP_MAX_CONFIGS  1024
+#define SWEEP_MAX_THREADS  64
+
+//////////////////////////////////////////////////////////////////
+// -sweep: many independent Part A data caches fed from one pass over
+// one trace. The trace is decoded once per block; each thread owns an
+// interleaved shard of the configurations and runs the whole block
+// through them, with a barrier between blocks.
+//
+// The spec is a comma separated list of sizeKB:assoc:linesize:repl,
+// each field may list alternatives with '/' and a group expands to
+// their cross product: 16/32/64:4/8:64:0 is six caches.
+//////////////////////////////////////////////////////////////////
+
+typedef struct Sweep_Config {
+  uns64  size_kb;
+  uns64  assoc;
+  uns64  linesize;
+  uns64  repl;
+  Cache *cache;
+} Sweep_Config;
+
+//////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////
+
+void    sweep_parse(char *spec);
+void    sweep_run(char *trace_filename, uns num_threads);
+
+#endif // SWEEP_H
@@ -6,7 +6,7 @@
 #define HIT   1
 #define MISS  0
 
-#define MAX_CORES 2
+#define MAX_CORES 16  // NUM_CORES (sim.c) is the runtime count
 
 // Precision for PrintStats
 #define UNS_PREC " %8llu"